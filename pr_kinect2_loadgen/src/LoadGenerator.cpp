@@ -0,0 +1,358 @@
+
+#include "LoadGenerator.h"
+
+namespace pr {
+
+// where each joint is relative to the waist, standing facing +z (m), JointIndex order
+static const ofVec3f kSkeleton[kNumJoints] = {
+    { 0, 0, 0 }, { 0, 0.25, 0 }, { 0, 0.5, 0 }, { 0, 0.62, 0 },                                 // waist torso neck head
+    { -0.18, 0.45, 0 }, { -0.22, 0.2, 0 }, { -0.24, -0.02, 0 }, { -0.25, -0.08, 0 },            // l shoulder elbow wrist hand
+    { 0.18, 0.45, 0 }, { 0.22, 0.2, 0 }, { 0.24, -0.02, 0 }, { 0.25, -0.08, 0 },                // r
+    { -0.1, -0.05, 0 }, { -0.1, -0.5, 0 }, { -0.1, -0.9, 0 }, { -0.1, -0.95, 0.1 },             // l hip knee ankle foot
+    { 0.1, -0.05, 0 }, { 0.1, -0.5, 0 }, { 0.1, -0.9, 0 }, { 0.1, -0.95, 0.1 },                 // r
+    { 0, 0.45, 0 }, { -0.25, -0.15, 0 }, { -0.23, -0.1, 0.03 }, { 0.25, -0.15, 0 }, { 0.23, -0.1, 0.03 }  // c_shoulder, hand tips, thumbs
+};
+
+// how far each joint swings forward (m) at the top of a stride, left side. the right side swings the other way
+static const float kSwing[kNumJoints] = {
+    0, 0, 0, 0,
+    0, -0.08, -0.15, -0.17,
+    0, 0, 0, 0,
+    0, 0.15, 0.3, 0.3,
+    0, 0, 0, 0,
+    0, -0.18, -0.17, 0, 0
+};
+
+// the right side's joint for each left one (-1 for the middle)
+static const int kMirror[kNumJoints] = {
+    -1, -1, -1, -1,
+    kJointRShoulder, kJointRElbow, kJointRWrist, kJointRHand,
+    -1, -1, -1, -1,
+    kJointRHip, kJointRKnee, kJointRAnkle, kJointRFoot,
+    -1, -1, -1, -1,
+    -1, kJointRHandTip, kJointRThumb, -1, -1
+};
+
+static const int kAppearanceBins = 64;       // APPEARANCE_BINS in the tracker
+static const int kAppearanceInterval = 10;   // frames between /appearance, the tracker only recomputes them now and then
+
+
+LoadGenerator::~LoadGenerator() {
+    stop();
+}
+
+
+void LoadGenerator::start() {
+    stop();
+
+    rng.seed(seed);
+    time = 0;
+    active_bodies = ramp > 0 ? min(1, num_bodies) : num_bodies;
+    pending.clear();
+    stats = Stats();
+    logged_failed = false;
+
+    sensors.clear();
+    for(int s=0; s<num_sensors; s++) {
+        unique_ptr<Sensor> sensor(new Sensor());
+        if(!sensor->socket.connect(host, base_port + s)) ofLogError() << "LoadGenerator::start couldn't open a socket to " << host << ":" << base_port + s;
+        sensor->bodies.resize(num_bodies);
+        sensors.push_back(std::move(sensor));
+    }
+
+    ofLogNotice() << "LoadGenerator::start " << num_sensors << " sensors to " << host << ":" << base_port << "+, " << num_bodies << " bodies each at " << rate << "fps";
+    startThread();
+}
+
+
+void LoadGenerator::stop() {
+    if(!isThreadRunning()) return;
+    stopThread();
+    waitForThread(false);
+}
+
+
+LoadGenerator::Stats LoadGenerator::getStats() {
+    std::unique_lock<std::mutex> lock(mutex);
+    return stats;
+}
+
+
+void LoadGenerator::threadedFunction() {
+    uint64_t period = 1000000 / max(rate, 1.0f);
+    uint64_t next_frame = ofGetElapsedTimeMicros();
+    float next_ramp = ramp;
+
+    while(isThreadRunning()) {
+        uint64_t now = ofGetElapsedTimeMicros();
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if(now >= next_frame) {
+            if(now - next_frame > period) stats.late++;
+
+            float dt = period / 1000000.0f;
+            time += dt;
+            if(ramp > 0 && time >= next_ramp && active_bodies < num_bodies) {
+                active_bodies++;
+                next_ramp += ramp;
+            }
+
+            stats.bodies = 0;
+            for(int s=0; s<sensors.size(); s++) makeFrame(s, next_frame, dt);
+
+            next_frame += period;
+            if(now > next_frame + 4 * period) next_frame = now;     // way behind, don't try to catch up
+        }
+
+        sendDue(now);
+
+        // until the next frame or datagram is due
+        uint64_t wake = next_frame;
+        if(!pending.empty()) wake = min(wake, pending.front().send_micros);
+        lock.unlock();
+        now = ofGetElapsedTimeMicros();
+        if(wake > now) std::this_thread::sleep_for(std::chrono::microseconds(wake - now));
+    }
+}
+
+
+void LoadGenerator::makeFrame(int s, uint64_t now_micros, float dt) {
+    Sensor& sensor = *sensors[s];
+
+    for(int i=0; i<sensor.bodies.size(); i++) {
+        Body& body = sensor.bodies[i];
+        body.is_new = false;
+
+        bool active = i < active_bodies;
+        bool leave = body.present && (!active || (stay_time > 0 && time >= body.next_change));
+        bool arrive = !body.present && active && time >= body.next_change;
+
+        if(leave) {
+            sensor.lost_users.push_back(body.user_id);
+            body.present = false;
+            body.next_change = time + random(1, 3);
+        } else if(arrive) {
+            body.user_id = sensor.next_user_id++;
+            body.present = true;
+            body.is_new = true;
+            body.next_change = time + (stay_time > 0 ? std::exponential_distribution<float>(1 / stay_time)(rng) : 0);
+
+            // a new walk somewhere in front of the sensor
+            body.center.set(random(-1, 1), 0, random(2.2, 3.5));
+            body.radius.set(random(0.3, 1.2), random(0.2, 0.8));
+            body.angle = random(0, TWO_PI);
+            body.angular_speed = random(0.8, 1.5) / ((body.radius.x + body.radius.y) / 2) * (chance(0.5) ? 1 : -1);
+            body.gait = random(0, TWO_PI);
+            moveBody(body, 0);
+        }
+
+        if(body.present) {
+            moveBody(body, dt);
+            stats.bodies++;
+        }
+    }
+
+    writeBundle(sensor, now_micros);
+    sensor.lost_users.clear();
+    sensor.frame_id++;
+    stats.frames++;
+
+    // the network
+    if(chance(loss)) {
+        stats.lost++;
+        return;
+    }
+
+    Datagram datagram;
+    datagram.sensor = s;
+    datagram.send_micros = now_micros + random(0, jitter * 1000);
+    if(!spare.empty()) {
+        datagram.data.swap(spare.back());
+        spare.pop_back();
+    }
+    datagram.data.assign(writer.getData(), writer.getData() + writer.getSize());
+
+    if(sensor.holding) {
+        // the one held back goes right after this one
+        sensor.held.send_micros = datagram.send_micros + 1;
+        schedule(datagram);
+        schedule(sensor.held);
+        sensor.holding = false;
+    } else if(chance(reorder)) {
+        sensor.held = std::move(datagram);
+        sensor.holding = true;
+        stats.reordered++;
+    } else {
+        schedule(datagram);
+    }
+}
+
+
+void LoadGenerator::moveBody(Body& body, float dt) {
+    body.angle += body.angular_speed * dt;
+    body.gait += TWO_PI * 0.9f * dt;
+
+    // facing the way it's walking
+    ofVec3f direction(-body.radius.x * sin(body.angle), 0, body.radius.y * cos(body.angle));
+    if(body.angular_speed < 0) direction = -direction;
+    body.quat.makeRotate(ofRadToDeg(atan2(direction.x, direction.z)), 0, 1, 0);
+    ofVec3f waist = body.center + ofVec3f(body.radius.x * cos(body.angle), 0, body.radius.y * sin(body.angle));
+
+    float swing = sin(body.gait);
+    for(int j=0; j<kNumJoints; j++) {
+        ofVec3f offset = kSkeleton[j];
+        offset.z += kSwing[j] * swing;
+        if(kMirror[j] >= 0) {
+            // right side mirrors the left, half a stride later
+            ofVec3f right = kSkeleton[kMirror[j]];
+            right.z -= kSwing[j] * swing;
+            ofVec3f pos = waist + body.quat * right;
+            body.vel[kMirror[j]] = dt > 0 ? (pos - body.pos[kMirror[j]]) / dt : ofVec3f();
+            body.pos[kMirror[j]] = pos;
+        }
+        ofVec3f pos = waist + body.quat * offset;
+        body.vel[j] = dt > 0 ? (pos - body.pos[j]) / dt : ofVec3f();
+        body.pos[j] = pos;
+    }
+}
+
+
+void LoadGenerator::writeBundle(Sensor& sensor, uint64_t capture_micros) {
+    static const char* const kHandStates[] = { "open", "closed", "lasso" };
+    char address[64];
+
+    writer.beginBundle();
+
+    writer.beginMessage("/frame", "ih");
+    writer.addInt(sensor.frame_id);
+    writer.addInt64(capture_micros);
+    writer.endMessage();
+
+    for(auto&& body : sensor.bodies) {
+        if(!body.is_new) continue;
+        writer.beginMessage("/new_user", "i");
+        writer.addInt(body.user_id);
+        writer.endMessage();
+    }
+
+    for(int user_id : sensor.lost_users) {
+        writer.beginMessage("/lost_user", "i");
+        writer.addInt(user_id);
+        writer.endMessage();
+    }
+
+    for(auto&& body : sensor.bodies) {
+        if(!body.is_new) continue;
+        writer.beginMessage("/calib_success", "i");
+        writer.addInt(body.user_id);
+        writer.endMessage();
+    }
+
+    for(auto&& body : sensor.bodies) {
+        if(!body.present) continue;
+        const ofVec3f& waist = body.pos[kJointWaist];
+
+        snprintf(address, sizeof(address), "/user/%d", body.user_id);
+        writer.beginMessage(address, "fffi");
+        writer.addFloat(waist.x);
+        writer.addFloat(waist.y);
+        writer.addFloat(waist.z);
+        writer.addInt(0);
+        writer.endMessage();
+
+        snprintf(address, sizeof(address), "/restricted/%d", body.user_id);
+        writer.beginMessage(address, "if");
+        writer.addInt(0);
+        writer.addFloat(1);
+        writer.endMessage();
+
+        for(int side=0; side<2; side++) {
+            snprintf(address, sizeof(address), side ? "/handstate/%d/right" : "/handstate/%d/left", body.user_id);
+            writer.beginMessage(address, "sf");
+            writer.addString(kHandStates[(body.user_id + side) % 3]);
+            writer.addFloat(1);
+            writer.endMessage();
+        }
+
+        snprintf(address, sizeof(address), "/lean/%d", body.user_id);
+        writer.beginMessage(address, "fff");
+        writer.addFloat(0);
+        writer.addFloat(0);
+        writer.addFloat(1);
+        writer.endMessage();
+    }
+
+    // x y z conf qx qy qz qw vx vy vz speed
+    for(auto&& body : sensor.bodies) {
+        if(!body.present) continue;
+        const ofVec4f& q = body.quat._v;
+        for(int j=0; j<kNumJoints; j++) {
+            snprintf(address, sizeof(address), "/skel/%d/%s", body.user_id, kJointNames[j]);
+            writer.beginMessage(address, "ffffffffffff");
+            writer.addFloat(body.pos[j].x);
+            writer.addFloat(body.pos[j].y);
+            writer.addFloat(body.pos[j].z);
+            writer.addFloat(1);
+            writer.addFloat(q.x);
+            writer.addFloat(q.y);
+            writer.addFloat(q.z);
+            writer.addFloat(q.w);
+            writer.addFloat(body.vel[j].x);
+            writer.addFloat(body.vel[j].y);
+            writer.addFloat(body.vel[j].z);
+            writer.addFloat(body.vel[j].length());
+            writer.endMessage();
+        }
+    }
+
+    // sensor 1m above the floor, level
+    writer.beginMessage("/floorplane", "ffff");
+    writer.addFloat(0);
+    writer.addFloat(1);
+    writer.addFloat(0);
+    writer.addFloat(1);
+    writer.endMessage();
+
+    if(sensor.frame_id % kAppearanceInterval == 0) {
+        unsigned char bins[kAppearanceBins];
+        for(auto&& body : sensor.bodies) {
+            if(!body.present) continue;
+            for(int b=0; b<kAppearanceBins; b++) bins[b] = (body.user_id * 31 + b * 7) % 256;
+            snprintf(address, sizeof(address), "/appearance/%d", body.user_id);
+            writer.beginMessage(address, "ib");
+            writer.addInt(100);
+            writer.addBlob(bins, kAppearanceBins);
+            writer.endMessage();
+        }
+    }
+}
+
+
+void LoadGenerator::schedule(Datagram& datagram) {
+    auto it = std::upper_bound(pending.begin(), pending.end(), datagram.send_micros, [](uint64_t t, const Datagram& d) { return t < d.send_micros; });
+    pending.insert(it, std::move(datagram));
+}
+
+
+void LoadGenerator::sendDue(uint64_t now_micros) {
+    int n = 0;
+    for(; n < pending.size() && pending[n].send_micros <= now_micros; n++) {
+        Datagram& datagram = pending[n];
+        if(sensors[datagram.sensor]->socket.send(datagram.data.data(), datagram.data.size())) {
+            stats.datagrams++;
+            stats.bytes += datagram.data.size();
+        } else {
+            // a tracker frame is one datagram, splitting it would make it two frames to the receiver. so it's lost, like it would be from the tracker
+            stats.failed++;
+            if(!logged_failed) {
+                ofLogError() << "LoadGenerator::sendDue couldn't send a " << datagram.data.size() << " byte frame to sensor " << datagram.sensor
+                    << (datagram.data.size() > 65507 ? ", over the 64KB UDP limit, try fewer --bodies" : "") << ". counting, not logging, any more";
+                logged_failed = true;
+            }
+        }
+        spare.push_back(std::move(datagram.data));
+    }
+    pending.erase(pending.begin(), pending.begin() + n);
+}
+
+}
@@ -0,0 +1,180 @@
+/*
+ Pretends to be a number of trackers, for finding out how much the receiver can take without any Kinects
+ - one stream per sensor, to base_port, base_port + 1 ...
+ - each sends what pr_kinect2_tracker sends with all its channels on every_frame (the most there can be), one bundle per frame:
+   /frame, /new_user, /lost_user, /calib_success, /user, /restricted, /handstate, /lean, /skel/<id>/<joint>, /floorplane, /appearance
+ - bodies walk around ellipses in front of the sensor, swinging arms and legs, and now and then leave and come back as a new user
+ - the network can be made worse: datagrams lost, delayed by up to jitter ms, or held back behind the next one (reordered)
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "DatagramSocket.h"
+#include "Joints.h"
+
+#include <random>
+
+namespace pr {
+
+// writes OSC bundles into a reusable buffer (big endian, strings padded to 4)
+class OscWriter {
+public:
+    OscWriter() { buffer.reserve(65536); }
+
+    // timetag "immediately", like ofxOscSender
+    void beginBundle() {
+        buffer.clear();
+        addPadded("#bundle");
+        addInt64(1);
+    }
+
+    // tags without the ','
+    void beginMessage(const char* address, const char* tags) {
+        message_start = buffer.size();
+        addInt(0);      // size, filled in by endMessage()
+        addPadded(address);
+        buffer.push_back(',');
+        addPadded(tags, 1);
+    }
+
+    void endMessage() {
+        writeInt(&buffer[message_start], buffer.size() - message_start - 4);
+    }
+
+    void addInt(int32_t i) {
+        buffer.resize(buffer.size() + 4);
+        writeInt(&buffer[buffer.size() - 4], i);
+    }
+
+    void addInt64(int64_t i) {
+        addInt(uint64_t(i) >> 32);
+        addInt(uint64_t(i) & 0xffffffff);
+    }
+
+    void addFloat(float f) {
+        uint32_t u;
+        memcpy(&u, &f, 4);
+        addInt(u);
+    }
+
+    void addString(const char* s)   { addPadded(s); }
+
+    void addBlob(const void* data, int size) {
+        addInt(size);
+        const char* p = (const char*)data;
+        buffer.insert(buffer.end(), p, p + size);
+        buffer.resize(buffer.size() + (4 - size % 4) % 4, 0);
+    }
+
+    const char* getData() const { return buffer.data(); }
+    int getSize() const         { return buffer.size(); }
+
+private:
+    vector<char> buffer;
+    int message_start = 0;
+
+    // 0 terminated and padded to 4, counting the already bytes written just before it
+    void addPadded(const char* s, int already = 0) {
+        int len = strlen(s);
+        buffer.insert(buffer.end(), s, s + len);
+        buffer.resize(buffer.size() + 4 - (already + len) % 4, 0);
+    }
+
+    static void writeInt(char* p, uint32_t u) {
+        p[0] = u >> 24;
+        p[1] = u >> 16;
+        p[2] = u >> 8;
+        p[3] = u;
+    }
+};
+
+
+class LoadGenerator : public ofThread {
+public:
+    string host = "127.0.0.1";
+    int base_port = 8001;
+    int num_sensors = 3;
+    int num_bodies = 6;         // per sensor
+    float rate = 30;            // frames per second
+    float loss = 0;             // fraction of datagrams not sent
+    float jitter = 0;           // datagrams go out up to this much later (ms)
+    float reorder = 0;          // fraction of datagrams held back behind the next one
+    float stay_time = 30;       // mean seconds a body stays before it's lost (and comes back as a new user), 0 for forever
+    float ramp = 0;             // seconds between adding a body to every sensor, 0 to start with all of them
+    uint32_t seed = 1;
+
+    struct Stats {
+        uint64_t frames = 0;    // per sensor frames made
+        uint64_t datagrams = 0; // sent
+        uint64_t bytes = 0;
+        uint64_t lost = 0;
+        uint64_t reordered = 0;
+        uint64_t late = 0;      // frames made after they were due, i.e. we can't keep up ourselves
+        uint64_t failed = 0;    // datagrams the socket wouldn't take, e.g. over 64KB with lots of bodies
+        int bodies = 0;         // present right now, all sensors
+    };
+
+    ~LoadGenerator();
+
+    // sockets and bodies, then sending
+    void start();
+    void stop();
+
+    Stats getStats();
+
+protected:
+    struct Body {
+        int user_id = -1;
+        bool present = false;
+        bool is_new = false;        // /new_user due
+        float next_change = 0;      // when it leaves / comes back (seconds)
+        ofVec3f center;             // of its walk
+        ofVec2f radius;
+        float angle = 0;            // around the walk
+        float angular_speed = 0;
+        float gait = 0;             // leg swing phase
+        ofVec3f pos[kNumJoints];
+        ofVec3f vel[kNumJoints];
+        ofQuaternion quat;
+    };
+
+    struct Datagram {
+        int sensor;
+        uint64_t send_micros;
+        vector<char> data;
+    };
+
+    struct Sensor {
+        DatagramSocket socket;
+        vector<Body> bodies;
+        vector<int> lost_users;     // /lost_user due
+        int next_user_id = 1;
+        int frame_id = 0;
+        bool holding = false;       // a datagram is held back, to go after the next one
+        Datagram held;
+    };
+
+    vector<unique_ptr<Sensor>> sensors;
+    OscWriter writer;
+    vector<Datagram> pending;       // to be sent, by send_micros
+    vector<vector<char>> spare;     // buffers of sent datagrams, for reuse
+    std::mt19937 rng;
+    float time = 0;                 // seconds since start
+    int active_bodies = 0;          // per sensor, while ramping up
+    bool logged_failed = false;     // the first failed send is logged, the rest only counted
+
+    Stats stats;                    // guarded by mutex
+
+    void threadedFunction() override;
+    void makeFrame(int s, uint64_t now_micros, float dt);
+    void moveBody(Body& body, float dt);
+    void writeBundle(Sensor& sensor, uint64_t capture_micros);
+    void schedule(Datagram& datagram);
+    void sendDue(uint64_t now_micros);
+
+    float random(float lo, float hi)    { return std::uniform_real_distribution<float>(lo, hi)(rng); }
+    bool chance(float p)                { return p > 0 && random(0, 1) < p; }
+};
+
+}
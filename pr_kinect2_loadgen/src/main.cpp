@@ -0,0 +1,105 @@
+/*
+ Synthetic load for pr_kinect2_receiver(d): pretends to be a number of trackers (see LoadGenerator.h)
+ - point the receiver's Receivers at base_port, base_port + 1 ... and watch its Processing Stats / /stats (Telemetry)
+   and each receiver's stream health while turning the load up
+ - --host h --port p --sensors n --bodies n (per sensor) --rate fps
+ - --loss fraction --jitter ms --reorder fraction to make the network worse
+ - --stay seconds (mean time a body stays before it's lost, 0 for forever), --ramp seconds (between adding bodies, 0 for all at once)
+ - --seed n, same seed same bodies. --duration seconds to stop by itself
+ e.g. --sensors 6 --bodies 6 --rate 30 --loss 0.02 --jitter 5 for a busy show on a bad network
+ */
+
+#include "ofMain.h"
+#include "ofAppNoWindow.h"
+
+#include "LoadGenerator.h"
+
+#include <csignal>
+
+#define kStatsInterval      5       // seconds between stats in the log
+
+static volatile sig_atomic_t exit_requested = 0;
+
+static void onSignal(int sig) {
+    exit_requested = 1;
+}
+
+
+class ofApp : public ofBaseApp {
+public:
+    pr::LoadGenerator generator;
+    float duration = 0;     // 0 for until stopped
+
+    pr::LoadGenerator::Stats last_stats;
+    float last_stats_time = 0;
+
+
+    //--------------------------------------------------------------
+    void setup() {
+        ofSetFrameRate(10);
+
+        std::signal(SIGTERM, onSignal);
+        std::signal(SIGINT, onSignal);
+
+        generator.start();
+        last_stats_time = ofGetElapsedTimef();
+    }
+
+
+    //--------------------------------------------------------------
+    void update() {
+        float now = ofGetElapsedTimef();
+        bool done = exit_requested || (duration > 0 && now >= duration);
+
+        if(done || now - last_stats_time > kStatsInterval) {
+            pr::LoadGenerator::Stats stats = generator.getStats();
+            float dt = max(now - last_stats_time, 0.001f);
+            ofLogNotice() << "pr_kinect2_loadgen: " << stats.bodies << " bodies, "
+                << ofToString((stats.frames - last_stats.frames) / dt, 1) << " frames/s, "
+                << ofToString((stats.datagrams - last_stats.datagrams) / dt, 1) << " datagrams/s, "
+                << ofToString((stats.bytes - last_stats.bytes) / dt / 1024, 1) << "KB/s, "
+                << stats.lost << " lost, " << stats.reordered << " reordered, " << stats.late << " late, " << stats.failed << " failed";
+            last_stats = stats;
+            last_stats_time = now;
+        }
+
+        if(done) {
+            ofLogNotice() << "pr_kinect2_loadgen: stopping";
+            ofExit();
+        }
+    }
+
+
+    //--------------------------------------------------------------
+    void exit() {
+        generator.stop();
+    }
+};
+
+//========================================================================
+int main(int argc, char* argv[]) {
+    ofAppNoWindow window;
+    ofSetupOpenGL(&window, 0, 0, OF_WINDOW);    // no GL context, just the main loop
+
+    ofApp* app = new ofApp();
+    pr::LoadGenerator& generator = app->generator;
+    for(int i=1; i<argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if(!has_value) ofLogError() << "pr_kinect2_loadgen: no value for " << arg;
+        else if(arg == "--host") generator.host = argv[++i];
+        else if(arg == "--port") generator.base_port = ofToInt(argv[++i]);
+        else if(arg == "--sensors") generator.num_sensors = ofToInt(argv[++i]);
+        else if(arg == "--bodies") generator.num_bodies = ofToInt(argv[++i]);
+        else if(arg == "--rate") generator.rate = ofToFloat(argv[++i]);
+        else if(arg == "--loss") generator.loss = ofToFloat(argv[++i]);
+        else if(arg == "--jitter") generator.jitter = ofToFloat(argv[++i]);
+        else if(arg == "--reorder") generator.reorder = ofToFloat(argv[++i]);
+        else if(arg == "--stay") generator.stay_time = ofToFloat(argv[++i]);
+        else if(arg == "--ramp") generator.ramp = ofToFloat(argv[++i]);
+        else if(arg == "--seed") generator.seed = ofToInt(argv[++i]);
+        else if(arg == "--duration") app->duration = ofToFloat(argv[++i]);
+        else ofLogError() << "pr_kinect2_loadgen: unknown argument " << arg;
+    }
+    ofRunApp(app);
+}
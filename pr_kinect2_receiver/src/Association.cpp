@@ -0,0 +1,288 @@
+
+#include "Association.h"
+#include "Receiver.h"
+
+namespace pr {
+
+float Associator::max_distance = 0.5;
+int Associator::lost_frames = 10;
+float Associator::process_noise = 20;
+float Associator::measurement_noise = 0.0004;
+float Associator::range_ref = 2;
+
+// cost of a pair that must never be assigned
+#define kNoMatch    1e6f
+
+
+Associator::Associator() : filters(kMaxTracks * kNumJoints) {
+    tracks.reserve(kMaxTracks);
+    for(int i=kMaxTracks-1; i>=0; i--) free_slots.push_back(i * kNumJoints);
+}
+
+
+// cells further out than this (or NaN) are all the same cell, the int conversion can't overflow
+#define kMaxCell    1e6f
+
+static int cellIndex(float x) {
+    if(x != x) return 0;
+    return floor(ofClamp(x, -kMaxCell, kMaxCell));
+}
+
+
+void Associator::cellOf(const ofVec3f& pos, int& cx, int& cz) const {
+    float size = max(max_distance, 0.01f);
+    cx = cellIndex(pos.x / size);
+    cz = cellIndex(pos.z / size);
+}
+
+
+void Associator::addToHash(int track) {
+    int cx, cz;
+    cellOf(tracks[track].person.joints.pos[kJointWaist], cx, cz);
+    cells[cellKey(cx, cz)].push_back(track);
+}
+
+
+int Associator::addTrack(Person::Ptr person) {
+    if(tracks.size() == kMaxTracks) {
+        ofLogError() << "Associator::addTrack no free tracks, max is " << kMaxTracks;
+        return -1;
+    }
+    tracks.push_back(Track());
+    Track& track = tracks.back();
+    track.id = next_id++;
+    track.slot = free_slots.back();
+    free_slots.pop_back();
+    filters.reset(track.slot, kNumJoints);
+    track.members.reserve(8);
+    track.members.push_back(person);
+    track.person = *person;
+    addToHash(tracks.size() - 1);
+    return tracks.size() - 1;
+}
+
+
+void Associator::update(const vector<Person::Ptr>& persons, float dt) {
+    uint64_t start = ofGetElapsedTimeMicros();
+
+    // advance all filters in one go, used or not
+    kalmanPredictArray(filters.pos.data(), filters.vel.data(), filters.p00.data(), filters.p01.data(), filters.p11.data(), filters.pos.size(), dt, process_noise);
+
+    for(auto&& cell : cells) cell.clear();
+    for(int t=0; t<tracks.size(); t++) {
+        tracks[t].members.clear();
+        tracks[t].lost_counter++;
+        addToHash(t);
+    }
+
+    // persons come grouped by receiver, assign one receiver at a time
+    for(int i=0; i<persons.size(); ) {
+        int n = 1;
+        while(i + n < persons.size() && persons[i + n]->sensor == persons[i]->sensor) n++;
+        assignSensor(&persons[i], n);
+        i += n;
+    }
+
+    // fuse the members of each track that was seen
+    for(auto&& track : tracks) {
+        if(track.members.empty()) continue;
+        track.lost_counter = 0;
+        fuse(track, dt);
+    }
+
+    // forget tracks nobody has seen for a while
+    for(int t=0; t<tracks.size(); ) {
+        if(tracks[t].lost_counter * dt * kReferenceFps > lost_frames) {
+            free_slots.push_back(tracks[t].slot);
+            std::swap(tracks[t], tracks.back());
+            tracks.pop_back();
+        } else {
+            t++;
+        }
+    }
+
+    millis = (ofGetElapsedTimeMicros() - start) / 1000.0f;
+}
+
+
+void Associator::assignSensor(const Person::Ptr* obs, int n) {
+    // tracks near any of these persons
+    candidates.clear();
+    for(int i=0; i<n; i++) {
+        int cx, cz;
+        cellOf(obs[i]->joints.pos[kJointWaist], cx, cz);
+        for(int dx=-1; dx<=1; dx++) {
+            for(int dz=-1; dz<=1; dz++) {
+                for(int t : cells[cellKey(cx + dx, cz + dz)]) {
+                    if(std::find(candidates.begin(), candidates.end(), t) == candidates.end()) candidates.push_back(t);
+                }
+            }
+        }
+    }
+
+    // persons x (candidate tracks + one 'new track' column per person)
+    int m = candidates.size();
+    int cols = m + n;
+    cost.assign(n * cols, kNoMatch);
+    for(int i=0; i<n; i++) {
+        for(int c=0; c<m; c++) {
+            float d = obs[i]->distance(tracks[candidates[c]].person);
+            if(d < max_distance) cost[i * cols + c] = d;
+        }
+        for(int c=m; c<cols; c++) cost[i * cols + c] = max_distance;
+    }
+
+    solve(cost, n, cols, assignment);
+
+    for(int i=0; i<n; i++) {
+        int c = assignment[i];
+        if(c < m && cost[i * cols + c] < max_distance) tracks[candidates[c]].members.push_back(obs[i]);
+        else addTrack(obs[i]);
+    }
+}
+
+
+void Associator::fuse(Track& track, float dt) {
+    ofVec3f* pos = &filters.pos[track.slot];
+    ofVec3f* vel = &filters.vel[track.slot];
+    float* p00 = &filters.p00[track.slot];
+    float* p01 = &filters.p01[track.slot];
+    float* p11 = &filters.p11[track.slot];
+
+    Joints& joints = track.person.joints;
+    float best_confidence = -1;
+    for(int j=0; j<kNumJoints; j++) {
+        joints.confidence[j] = 0;
+        joints.pos_target[j].set(0, 0, 0);
+        joints.vel_target[j].set(0, 0, 0);
+        weights[j] = 0;
+    }
+    ofVec4f quat_sum[kNumJoints];
+
+    // one kalman update per member, each as noisy as it is unsure and far from its sensor
+    float range_scale = 1 / max(range_ref, 0.01f);
+    for(auto member : track.members) {
+        const Joints& m = member->joints;
+        float total_confidence = 0;
+        for(int j=0; j<kNumJoints; j++) {
+            float c = m.confidence[j];
+            float range = m.range[j] * range_scale;
+            noise[j] = c > 0 ? measurement_noise * (1 + range * range) / c : 0;
+
+            // weighted means of what isn't filtered
+            float w = c > 0 ? 1 / noise[j] : 0;
+            weights[j] += w;
+            joints.pos_target[j] += m.pos_target[j] * w;
+            joints.vel_target[j] += m.vel_target[j] * w;
+            joints.confidence[j] = max(joints.confidence[j], c);
+            total_confidence += c;
+
+            // quaternions q and -q are the same rotation, flip onto the same side before summing
+            ofVec4f q = m.quat[j].asVec4();
+            if(q.dot(quat_sum[j]) < 0) q = -q;
+            quat_sum[j] += q * w;
+        }
+        kalmanUpdateArray(pos, vel, p00, p01, p11, m.pos_target, noise, kNumJoints);
+
+        member->global_id = track.id;
+        if(total_confidence > best_confidence) {
+            best_confidence = total_confidence;
+            track.person.color = member->color;
+            track.person.user_id = member->user_id;
+        }
+    }
+
+    for(int j=0; j<kNumJoints; j++) {
+        if(weights[j] <= 0) continue;
+        joints.pos_target[j] /= weights[j];
+        joints.vel_target[j] /= weights[j];
+        float len = quat_sum[j].length();
+        if(len > 0) joints.quat[j] = ofQuaternion(quat_sum[j] / len);
+        joints.euler[j] = joints.quat[j].getEuler();
+    }
+
+    // filtered position and velocity, smoothed as the receivers smooth theirs (0 leaves it to the filters),
+    // then the same derived values as Receiver::update
+    smoothArray(joints.pos[0].getPtr(), pos[0].getPtr(), kNumJoints * 3, rateSmoothing(Receiver::pos_smoothing, dt));
+    smoothArray(joints.vel[0].getPtr(), vel[0].getPtr(), kNumJoints * 3, rateSmoothing(Receiver::vel_smoothing, dt));
+    lengthArray(joints.speed, joints.vel, kNumJoints);
+    springArray(joints.springy_pos[0].getPtr(), joints.springy_vel[0].getPtr(), joints.pos[0].getPtr(), kNumJoints * 3, Receiver::spring_strength, Receiver::spring_damping, dt * kReferenceFps);
+    parentVectorArray(joints.vec, joints.pos, JointSchema::get().parents, kNumJoints);
+
+    track.person.global_id = track.id;
+}
+
+
+// hungarian algorithm with potentials, O(rows^2 * cols)
+void Associator::solve(const vector<float>& cost, int rows, int cols, vector<int>& assignment) {
+    const float inf = std::numeric_limits<float>::max();
+
+    // 1 based, row / column 0 are virtual
+    u.assign(rows + 1, 0);
+    v.assign(cols + 1, 0);
+    p.assign(cols + 1, 0);
+    way.assign(cols + 1, 0);
+
+    for(int i=1; i<=rows; i++) {
+        p[0] = i;
+        int j0 = 0;
+        minv.assign(cols + 1, inf);
+        used.assign(cols + 1, false);
+        do {
+            used[j0] = true;
+            int i0 = p[j0], j1 = 0;
+            float delta = inf;
+            for(int j=1; j<=cols; j++) {
+                if(used[j]) continue;
+                float cur = cost[(i0 - 1) * cols + (j - 1)] - u[i0] - v[j];
+                if(cur < minv[j]) { minv[j] = cur; way[j] = j0; }
+                if(minv[j] < delta) { delta = minv[j]; j1 = j; }
+            }
+            for(int j=0; j<=cols; j++) {
+                if(used[j]) { u[p[j]] += delta; v[j] -= delta; }
+                else minv[j] -= delta;
+            }
+            j0 = j1;
+        } while(p[j0] != 0);
+        do {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while(j0);
+    }
+
+    assignment.assign(rows, -1);
+    for(int j=1; j<=cols; j++) if(p[j]) assignment[p[j] - 1] = j - 1;
+}
+
+
+void Associator::getPersons(vector<Person::Ptr>& out) {
+    out.clear();
+    for(auto&& track : tracks) if(track.lost_counter == 0) out.push_back(&track.person);
+}
+
+
+void Associator::loadFromXml(ofXml& xml) {
+	if (!xml.exists("//Settings/Association")) return;
+	xml.setTo("//Settings/Association");
+	max_distance = xml.getFloatValue("max_distance");
+	lost_frames = xml.getIntValue("lost_frames");
+	if (xml.exists("process_noise")) {
+		process_noise = xml.getFloatValue("process_noise");
+		measurement_noise = xml.getFloatValue("measurement_noise");
+		range_ref = xml.getFloatValue("range_ref");
+	}
+}
+
+void Associator::saveToXml(ofXml& xml) const {
+	xml.setTo("//Settings");
+	xml.addChild("Association");
+	xml.setTo("Association");
+	xml.addValue("max_distance", ofToString(max_distance));
+	xml.addValue("lost_frames", ofToString(lost_frames));
+	xml.addValue("process_noise", ofToString(process_noise));
+	xml.addValue("measurement_noise", ofToString(measurement_noise));
+	xml.addValue("range_ref", ofToString(range_ref));
+}
+
+}
@@ -0,0 +1,88 @@
+/*
+ Works out which persons from different receivers are the same physical person
+ - tracks are the physical persons, they keep their id for as long as any receiver sees them
+ - every frame the persons of each receiver are assigned to tracks optimally (hungarian algorithm),
+   by skeleton distance. a receiver can't see the same person twice, so at most one per track per receiver
+ - only tracks in nearby cells of a floor plane (x, z) hash are considered for each person
+ - the joints of all persons in a track are fused into one skeleton with per joint kalman filters,
+   trusting each by its confidence and how far it was from its sensor (see Fusion.h)
+ - the filters see the raw targets, the receivers' pos / vel smoothing is applied to what comes out of them
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "Person.h"
+#include "Fusion.h"
+
+namespace pr {
+
+class Associator {
+public:
+    static float max_distance;      // (m) skeletons further apart than this are never the same person
+    static int lost_frames;         // forget tracks that no receiver has seen for this many frames (at kReferenceFps)
+    static float process_noise;     // how quickly joints are expected to change velocity. higher follows faster, lower is smoother
+    static float measurement_noise; // (m^2) variance of a confident joint at range_ref from its sensor
+    static float range_ref;         // (m) measurement noise grows with (distance to sensor / range_ref)^2
+
+    // max number of physical persons tracked
+    static const int kMaxTracks = 64;
+
+    struct Track {
+        int id;
+        int lost_counter = 0;
+        int slot;                       // first of this track's kNumJoints filters
+        vector<Person::Ptr> members;    // persons this track was seen as this frame, at most one per receiver
+        Person person;                  // fused skeleton, what goes downstream. global_id is the track id
+    };
+
+    Associator();
+
+    // assign persons (from all receivers, grouped by receiver) to tracks and fuse them. sets their global_id.
+    // dt is the time since the last update (seconds)
+    void update(const vector<Person::Ptr>& persons, float dt);
+
+    // one person per physical person currently seen
+    void getPersons(vector<Person::Ptr>& out);
+
+    int numTracks() const   { return tracks.size(); }
+    float getMillis() const { return millis; }
+
+    void loadFromXml(ofXml& xml);
+    void saveToXml(ofXml& xml) const;
+
+protected:
+    vector<Track> tracks;           // reserved to kMaxTracks, never reallocates
+    int next_id = 0;
+    float millis = 0;               // time the last update took
+
+    // kalman filters for kMaxTracks * kNumJoints joints, each track owns kNumJoints of them
+    JointFilters filters;
+    vector<int> free_slots;
+
+    // floor plane hash of track indices, cells are max_distance wide
+    static const int kHashSize = 256;
+    vector<int> cells[kHashSize];
+
+    // scratch, kept to avoid allocating every frame
+    vector<int> candidates;
+    vector<float> cost;
+    vector<int> assignment;
+    vector<float> u, v, minv;
+    vector<int> p, way;
+    vector<bool> used;
+    float noise[kNumJoints];
+    float weights[kNumJoints];
+
+    int cellKey(int cx, int cz) const   { return ((uint32_t)cx * 73856093u ^ (uint32_t)cz * 19349663u) & (kHashSize - 1); }
+    void cellOf(const ofVec3f& pos, int& cx, int& cz) const;
+    void addToHash(int track);
+    void assignSensor(const Person::Ptr* obs, int n);
+    int addTrack(Person::Ptr person);
+    void fuse(Track& track, float dt);
+
+    // min cost assignment of rows to columns (rows <= cols). assignment[row] = column
+    void solve(const vector<float>& cost, int rows, int cols, vector<int>& assignment);
+};
+
+}
@@ -0,0 +1,171 @@
+
+#include "ConfigWatcher.h"
+
+#include <sys/stat.h>
+
+#ifdef TARGET_LINUX
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace pr {
+
+ConfigWatcher::~ConfigWatcher() {
+    stop();
+}
+
+
+void ConfigWatcher::watch(const string& filename) {
+    File file;
+    file.filename = filename;
+    file.path = ofToDataPath(filename, true);
+    files.push_back(file);
+}
+
+
+void ConfigWatcher::start() {
+    if(isThreadRunning()) return;
+
+    // what's there now was loaded at startup
+    for(auto&& file : files) file.seen = file.loaded = stampOf(file.path);
+
+#ifdef TARGET_LINUX
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    set<string> folders;
+    for(auto&& file : files) folders.insert(ofFilePath::getEnclosingDirectory(file.path, false));
+    for(auto&& folder : folders) {
+        if(inotify_fd < 0 || inotify_add_watch(inotify_fd, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) < 0) {
+            ofLogWarning() << "ConfigWatcher::start can't watch " << folder << ", only checking every " << kPollMillis << "ms";
+        }
+    }
+#endif
+
+    startThread();
+}
+
+
+void ConfigWatcher::stop() {
+    if(isThreadRunning()) {
+        stopThread();
+        waitForThread(false);
+    }
+#ifdef TARGET_LINUX
+    if(inotify_fd >= 0) close(inotify_fd);
+    inotify_fd = -1;
+#endif
+}
+
+
+void ConfigWatcher::reload() {
+    reload_requested = true;
+}
+
+
+void ConfigWatcher::saved(const string& filename) {
+    std::unique_lock<std::mutex> lock(mutex);
+    File* file = find(filename);
+    if(!file) return;
+    file->seen = file->loaded = stampOf(file->path);
+    file->dirty = false;
+    file->generation++;
+    file->parsed.reset();
+}
+
+
+shared_ptr<ofXml> ConfigWatcher::take(const string& filename) {
+    std::unique_lock<std::mutex> lock(mutex);
+    File* file = find(filename);
+    if(!file) return NULL;
+    shared_ptr<ofXml> parsed;
+    parsed.swap(file->parsed);
+    return parsed;
+}
+
+
+void ConfigWatcher::threadedFunction() {
+    bool settling = false;
+    while(isThreadRunning()) {
+        // back sooner while a change is settling
+        wait(settling ? kSettleMillis : kPollMillis);
+        uint64_t now = ofGetElapsedTimeMicros();
+        bool force = reload_requested.exchange(false);
+        settling = false;
+        for(auto&& file : files) settling |= check(file, now, force);
+    }
+}
+
+
+void ConfigWatcher::wait(int millis) {
+#ifdef TARGET_LINUX
+    if(inotify_fd >= 0) {
+        pollfd pfd = { inotify_fd, POLLIN, 0 };
+        if(poll(&pfd, 1, millis) > 0) {
+            // only waking up matters, which file changed is told by the stamps
+            char buffer[4096];
+            while(read(inotify_fd, buffer, sizeof(buffer)) > 0) {}
+        }
+        return;
+    }
+#endif
+    ofSleepMillis(millis);
+}
+
+
+bool ConfigWatcher::check(File& file, uint64_t now_micros, bool force) {
+    Stamp stamp = stampOf(file.path);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if(stamp != file.seen) {
+        file.seen = stamp;
+        file.changed_micros = now_micros;
+    }
+    file.dirty = file.dirty || force || file.seen != file.loaded;
+
+    // gone (e.g. halfway through being replaced) loads when it's back
+    bool settled = force || now_micros - file.changed_micros >= kSettleMillis * 1000;
+    if(!file.dirty || !settled || !stamp.mtime) return file.dirty;
+
+    file.dirty = false;
+    file.loaded = stamp;
+    int generation = file.generation;
+    lock.unlock();
+
+    // the slow part, nothing waits on it
+    shared_ptr<ofXml> xml(new ofXml());
+    if(!xml->load(file.path)) {
+        ofLogError() << "ConfigWatcher::check couldn't parse " << file.path << ", keeping the settings in use";
+        return false;
+    }
+
+    lock.lock();
+    if(generation == file.generation) {
+        file.parsed = xml;
+        ofLogNotice() << "ConfigWatcher::check loaded " << file.path;
+    }
+    return false;
+}
+
+
+ConfigWatcher::File* ConfigWatcher::find(const string& filename) {
+    for(auto&& file : files) if(file.filename == filename) return &file;
+    ofLogError() << "ConfigWatcher::find not watching " << filename;
+    return NULL;
+}
+
+
+ConfigWatcher::Stamp ConfigWatcher::stampOf(const string& path) {
+    Stamp stamp;
+    struct stat st;
+    if(stat(path.c_str(), &st) == 0) {
+        stamp.size = st.st_size;
+#ifdef TARGET_LINUX
+        stamp.mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+        stamp.mtime = st.st_mtime;      // only seconds, the size catches most saves within one
+#endif
+    }
+    return stamp;
+}
+
+}
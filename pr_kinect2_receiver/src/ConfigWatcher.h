@@ -0,0 +1,76 @@
+/*
+ Watches settings files and parses them on its own thread when they change, so a reload never holds up a frame
+ - changes are noticed by the files' modification times and sizes, checked every kPollMillis, and on linux straight away
+   through inotify (on their folders, editors often save by renaming a new file over the old one)
+ - a change is only loaded once the file has stayed the same for kSettleMillis, editors write in more than one go
+ - a file that doesn't parse is logged and skipped, whatever was loaded before stays in use
+ - take() hands over the newest parsed version, to be applied at a frame boundary by whoever owns the settings
+ */
+
+#pragma once
+
+#include "ofMain.h"
+
+namespace pr {
+
+class ConfigWatcher : public ofThread {
+public:
+    static const int kPollMillis = 500;
+    static const int kSettleMillis = 200;
+
+    ~ConfigWatcher();
+
+    // filename in data. before start()
+    void watch(const string& filename);
+
+    void start();
+    void stop();
+
+    // parse all watched files again, changed or not (e.g. on 'l' or SIGHUP)
+    void reload();
+
+    // after writing a watched file ourselves, so it isn't loaded straight back over what's running
+    void saved(const string& filename);
+
+    // newest parse of filename since the last take(), NULL if there's none. never waits on a parse
+    shared_ptr<ofXml> take(const string& filename);
+
+protected:
+    // enough to tell a file changed, without reading it
+    struct Stamp {
+        int64_t mtime = 0;      // 0 if the file isn't there
+        int64_t size = 0;
+        bool operator!=(const Stamp& other) const   { return mtime != other.mtime || size != other.size; }
+    };
+
+    struct File {
+        string filename;
+        string path;
+        Stamp seen;             // when last checked
+        Stamp loaded;           // what was last parsed (or saved)
+        uint64_t changed_micros = 0;    // when seen last changed
+        bool dirty = false;     // seen != loaded, waiting to settle
+        int generation = 0;     // bumped by saved(), so a parse that was already running is thrown away
+        shared_ptr<ofXml> parsed;
+    };
+
+    // guarded by mutex, the list itself is fixed once started
+    vector<File> files;
+    atomic<bool> reload_requested { false };
+
+#ifdef TARGET_LINUX
+    int inotify_fd = -1;
+#endif
+
+    void threadedFunction() override;
+
+    // until something may have changed, or for millis
+    void wait(int millis);
+
+    // parses file if it changed and has settled. returns true while it's waiting to settle
+    bool check(File& file, uint64_t now_micros, bool force);
+    File* find(const string& filename);
+    static Stamp stampOf(const string& path);
+};
+
+}
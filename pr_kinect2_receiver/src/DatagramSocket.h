@@ -0,0 +1,149 @@
+/*
+ Minimal UDP socket, for reading whole datagrams straight into our own buffers (non-blocking),
+ and for sending ones we've encoded ourselves (ofxOscReceiver / ofxOscSender copy every message into an ofxOscMessage)
+ */
+
+#pragma once
+
+#include "ofMain.h"
+
+#ifdef TARGET_WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+namespace pr {
+
+class DatagramSocket {
+public:
+#ifdef TARGET_WIN32
+    typedef SOCKET Handle;
+    static const Handle kInvalid = INVALID_SOCKET;
+#else
+    typedef int Handle;
+    static const Handle kInvalid = -1;
+#endif
+
+    ~DatagramSocket() { close(); }
+
+    // bind to port on all interfaces. returns false on failure
+    bool bind(int port) {
+        close();
+        initNetwork();
+
+        handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if(handle == kInvalid) {
+            ofLogError() << "DatagramSocket::bind could not create socket";
+            return false;
+        }
+
+        // big receive buffer, so a stalled frame doesn't overflow the kernel queue
+        int rcvbuf = 4 * 1024 * 1024;
+        setsockopt(handle, SOL_SOCKET, SO_RCVBUF, (const char*)&rcvbuf, sizeof(rcvbuf));
+
+        int reuse = 1;
+        setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if(::bind(handle, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            ofLogError() << "DatagramSocket::bind could not bind to port " << port;
+            close();
+            return false;
+        }
+
+#ifdef TARGET_WIN32
+        u_long nonblocking = 1;
+        ioctlsocket(handle, FIONBIO, &nonblocking);
+#else
+        fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK);
+#endif
+        return true;
+    }
+
+    // send to host:port from now on. returns false on failure
+    bool connect(const string& host, int port) {
+        close();
+        initNetwork();
+
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* result = NULL;
+        if(getaddrinfo(host.c_str(), ofToString(port).c_str(), &hints, &result) != 0 || !result) {
+            ofLogError() << "DatagramSocket::connect could not resolve " << host;
+            return false;
+        }
+
+        handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        bool ok = handle != kInvalid && ::connect(handle, result->ai_addr, result->ai_addrlen) == 0;
+        freeaddrinfo(result);
+        if(!ok) {
+            ofLogError() << "DatagramSocket::connect could not connect to " << host << ":" << port;
+            close();
+        }
+        return ok;
+    }
+
+    // sends one datagram to where we're connected. returns false if it wasn't sent
+    bool send(const char* data, int size) {
+        if(handle == kInvalid) return false;
+        return ::send(handle, data, size, 0) == size;
+    }
+
+    void close() {
+        if(handle == kInvalid) return;
+#ifdef TARGET_WIN32
+        closesocket(handle);
+#else
+        ::close(handle);
+#endif
+        handle = kInvalid;
+    }
+
+    bool isOpen() const     { return handle != kInvalid; }
+    Handle getHandle() const  { return handle; }
+
+    // reads one datagram into buffer. returns its size, 0 if nothing is waiting, -1 on error
+    int receive(char* buffer, int size) {
+        if(handle == kInvalid) return -1;
+        int n = recv(handle, buffer, size, 0);
+        if(n >= 0) return n;
+#ifdef TARGET_WIN32
+        int err = WSAGetLastError();
+        // WSAEMSGSIZE: datagram was bigger than buffer and got truncated, WSAECONNRESET: icmp port unreachable from an earlier send
+        if(err == WSAEWOULDBLOCK || err == WSAECONNRESET) return 0;
+        if(err == WSAEMSGSIZE) return size;
+#else
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+#endif
+        return -1;
+    }
+
+    static void initNetwork() {
+#ifdef TARGET_WIN32
+        static bool initialized = false;
+        if(!initialized) {
+            WSADATA wsaData;
+            WSAStartup(MAKEWORD(2, 2), &wsaData);
+            initialized = true;
+        }
+#endif
+    }
+
+private:
+    Handle handle = kInvalid;
+};
+
+}
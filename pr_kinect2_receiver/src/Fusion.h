@@ -0,0 +1,62 @@
+/*
+ Kalman filters for fusing joint positions seen by several receivers into one.
+ One constant velocity filter per joint. Measurement and process noise are the same on all axes,
+ so a single 2x2 covariance (p00 p01 / p01 p11) per joint serves x, y and z.
+ State is kept struct of arrays for any number of joints, so the kernels run over all of them at once.
+ */
+
+#pragma once
+
+#include "ofMain.h"
+
+namespace pr {
+
+struct JointFilters {
+    vector<ofVec3f> pos;            // filtered position
+    vector<ofVec3f> vel;            // filtered velocity (per second)
+    vector<float> p00, p01, p11;    // covariance of position / velocity
+
+    JointFilters(int n) : pos(n), vel(n), p00(n), p01(n), p11(n) { reset(0, n); }
+
+    // forget n joints starting at first, the next measurement is taken as is
+    void reset(int first, int n) {
+        for(int i=first; i<first+n; i++) {
+            pos[i].set(0, 0, 0);
+            vel[i].set(0, 0, 0);
+            p00[i] = 1e3;
+            p01[i] = 0;
+            p11[i] = 1;
+        }
+    }
+};
+
+
+// advance n filters by dt seconds. q is the process noise (acceleration variance)
+inline void kalmanPredictArray(ofVec3f* __restrict pos, const ofVec3f* __restrict vel, float* __restrict p00, float* __restrict p01, float* __restrict p11, int n, float dt, float q) {
+    float q00 = q * dt * dt * dt / 3, q01 = q * dt * dt / 2, q11 = q * dt;
+    for(int i=0; i<n; i++) {
+        pos[i].x += vel[i].x * dt;
+        pos[i].y += vel[i].y * dt;
+        pos[i].z += vel[i].z * dt;
+        p00[i] += dt * (2 * p01[i] + dt * p11[i]) + q00;
+        p01[i] += dt * p11[i] + q01;
+        p11[i] += q11;
+    }
+}
+
+// apply one measurement z[i] with variance r[i] to each of n filters. r[i] <= 0 means no measurement for that one
+inline void kalmanUpdateArray(ofVec3f* __restrict pos, ofVec3f* __restrict vel, float* __restrict p00, float* __restrict p01, float* __restrict p11, const ofVec3f* __restrict z, const float* __restrict r, int n) {
+    for(int i=0; i<n; i++) {
+        if(r[i] <= 0) continue;
+        float s = 1 / (p00[i] + r[i]);
+        float k0 = p00[i] * s, k1 = p01[i] * s;
+        ofVec3f y = z[i] - pos[i];
+        pos[i] += y * k0;
+        vel[i] += y * k1;
+        p11[i] -= k1 * p01[i];
+        p01[i] *= 1 - k0;
+        p00[i] *= 1 - k0;
+    }
+}
+
+}
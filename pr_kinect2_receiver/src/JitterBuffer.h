@@ -0,0 +1,211 @@
+/*
+ Holds the last few frames of one tracker, ordered by capture time, so all Receivers can be
+ sampled at the same moment in the past (a little behind now) instead of at whatever just arrived
+ - capture times from /frame are mapped onto our clock with the smallest transit seen (the tracker's clock isn't ours)
+ - trackers that don't send /frame are timed by arrival
+ - the delay adapts to the frame interval plus the jitter seen on this tracker
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "SensorFrame.h"
+
+namespace pr {
+
+class JitterBuffer {
+public:
+    // frames held. more than the biggest delay needs at 30fps
+    static const int kCapacity = 8;
+
+    JitterBuffer() { clear(); }
+
+    void clear() {
+        count = 0;
+        for(int i=0; i<kNumSlots; i++) free_slots[i] = i;
+        num_free = kNumSlots;
+        have_offset = false;
+        last_time = -1;
+        last_arrival = 0;
+        last_sampled = 0;
+        last_interpolated = false;
+    }
+
+    // frame to assemble the next datagram into. always a spare slot, nothing buffered is touched until commit()
+    SensorFrame& beginWrite() {
+        write_slot = free_slots[num_free - 1];
+        slots[write_slot].clear();
+        return slots[write_slot];
+    }
+
+    // put the frame from beginWrite() into the buffer, recycling the oldest frame if it's full.
+    // frames that carry nothing are dropped
+    void commit() {
+        SensorFrame& frame = slots[write_slot];
+        if(frame.isEmpty()) return;
+
+        int64_t arrival = frame.arrival_micros;
+        int64_t time;
+        float lateness;
+        if(frame.frame_id >= 0) {
+            // capture time on our clock is capture + the smallest transit (arrival - capture) seen.
+            // creep towards bigger transits very slowly, so clock drift between the machines is followed
+            int64_t transit = arrival - frame.capture_micros;
+            if(!have_offset || transit < offset) offset = transit;
+            else offset += (transit - offset) / 1024;
+            have_offset = true;
+
+            time = frame.capture_micros + offset;
+            lateness = transit - offset;
+        } else {
+            // no capture time, expect frames evenly spaced and count deviations as jitter
+            time = arrival;
+            lateness = last_arrival ? fabs((arrival - last_arrival) - interval) : 0;
+        }
+
+        // stale or duplicate (e.g. reordered behind what we've already sampled past)
+        if(time <= last_time - kCapacity * interval || findTime(time) >= 0) return;
+
+        // full, and older than anything buffered, it would be the one recycled
+        if(count == kCapacity && time < times[order[0]]) return;
+
+        if(last_arrival) {
+            float dt = time - last_time;
+            if(dt > 0) interval += (min(dt, 1e6f) - interval) / 16;
+        }
+        jitter += (lateness - jitter) / 16;
+        last_time = max(last_time, time);
+        last_arrival = arrival;
+
+        // write_slot is the top of free_slots
+        num_free--;
+        if(count == kCapacity) {
+            free_slots[num_free++] = order[0];
+            remove(0);
+        }
+
+        // insert sorted by time
+        times[write_slot] = time;
+        seqs[write_slot] = ++next_seq;
+        int i = count;
+        while(i > 0 && times[order[i - 1]] > time) { order[i] = order[i - 1]; i--; }
+        order[i] = write_slot;
+        count++;
+    }
+
+    // how far behind now to sample, to (most likely) have frames on both sides of the sample time
+    int64_t getDelay(float jitter_mult, float min_delay, float max_delay) const {
+        return ofClamp(interval + jitter_mult * jitter, min_delay, max_delay);
+    }
+
+    float getJitter() const     { return jitter; }
+    float getInterval() const   { return interval; }
+    int size() const            { return count; }
+
+    // frame as it was at time, interpolated between the frames on either side.
+    // returns false if there is nothing new since the last call
+    bool sample(int64_t time, SensorFrame& out) {
+        if(count == 0) return false;
+
+        // frames before the one just before time won't be needed again
+        while(count > 1 && times[order[1]] <= time) {
+            free_slots[num_free++] = order[0];
+            remove(0);
+        }
+
+        const SensorFrame& a = slots[order[0]];
+        if(count == 1 || time <= times[order[0]]) {
+            // nothing to interpolate with (yet), hold the frame until a newer one is due
+            if(seqs[order[0]] == last_sampled && !last_interpolated) return false;
+            out = a;
+            last_sampled = seqs[order[0]];
+            last_interpolated = false;
+            return true;
+        }
+
+        const SensorFrame& b = slots[order[1]];
+        float t = float(time - times[order[0]]) / float(times[order[1]] - times[order[0]]);
+        interpolate(a, b, t, out);
+        last_sampled = seqs[order[0]];
+        last_interpolated = true;
+        return true;
+    }
+
+    // forget user_id in all buffered frames (after /lost_user), so it doesn't come back from the past
+    void removeUser(int user_id) {
+        for(int i=0; i<count; i++) {
+            SensorFrame& frame = slots[order[i]];
+            for(int b=0; b<frame.num_bodies; b++) {
+                if(frame.bodies[b].user_id == user_id) {
+                    frame.bodies[b] = frame.bodies[--frame.num_bodies];
+                    break;
+                }
+            }
+        }
+    }
+
+protected:
+    // one more than fits in the buffer, the one being written
+    static const int kNumSlots = kCapacity + 1;
+
+    SensorFrame slots[kNumSlots];
+    int64_t times[kNumSlots];       // per slot, on our clock
+    uint32_t seqs[kNumSlots];       // per slot, order of arrival
+    uint32_t next_seq = 0;
+    int order[kCapacity];           // slots in the buffer, oldest first
+    int count;
+    int free_slots[kNumSlots];
+    int num_free;
+    int write_slot = 0;
+
+    bool have_offset;
+    int64_t offset = 0;             // tracker clock -> our clock
+    int64_t last_time;              // newest frame time
+    int64_t last_arrival;
+    float interval = 33333;         // frame interval (micros), averaged
+    float jitter = 0;               // how late frames arrive (micros), averaged
+
+    uint32_t last_sampled;          // seq of the frame returned from sample() last time
+    bool last_interpolated;
+
+    void remove(int i) {
+        for(; i < count - 1; i++) order[i] = order[i + 1];
+        count--;
+    }
+
+    int findTime(int64_t time) const {
+        for(int i=0; i<count; i++) if(times[order[i]] == time) return i;
+        return -1;
+    }
+
+    // bodies from b, blended with their state in a where they're in both
+    static void interpolate(const SensorFrame& a, const SensorFrame& b, float t, SensorFrame& out) {
+        out.frame_id = b.frame_id;
+        out.capture_micros = b.capture_micros;
+        out.arrival_micros = b.arrival_micros;
+        out.has_floor = b.has_floor;
+        out.floor = b.floor;
+        out.num_bodies = b.num_bodies;
+
+        for(int i=0; i<b.num_bodies; i++) {
+            const SensorFrame::Body& body_b = b.bodies[i];
+            SensorFrame::Body& body = out.bodies[i];
+            body = body_b;
+
+            const SensorFrame::Body* body_a = NULL;
+            for(int k=0; k<a.num_bodies; k++) if(a.bodies[k].user_id == body_b.user_id) body_a = &a.bodies[k];
+            if(!body_a) continue;
+
+            uint32_t both = body_a->joint_mask & body_b.joint_mask;
+            for(int j=0; j<kNumJoints; j++) {
+                if(!(both & (1u << j))) continue;
+                body.confidence[j] = ofLerp(body_a->confidence[j], body_b.confidence[j], t);
+                body.pos[j] = body_a->pos[j].getInterpolated(body_b.pos[j], t);
+                body.vel[j] = body_a->vel[j].getInterpolated(body_b.vel[j], t);
+                body.quat[j].slerp(t, body_a->quat[j], body_b.quat[j]);
+            }
+        }
+    }
+};
+
+}
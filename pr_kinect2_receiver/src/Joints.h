@@ -0,0 +1,151 @@
+/*
+ Fixed joint indices and the per frame math that runs over whole joint arrays.
+ Kernels work on plain float arrays so the compiler can vectorize them
+ (an ofVec3f[n] is 3*n contiguous floats).
+ */
+
+#pragma once
+
+#include "ofMain.h"
+
+namespace pr {
+
+// joint indices, same order as JointNames in joints.xml
+enum JointIndex {
+    kJointWaist,
+    kJointTorso,
+    kJointNeck,
+    kJointHead,
+
+    kJointLShoulder,
+    kJointLElbow,
+    kJointLWrist,
+    kJointLHand,
+
+    kJointRShoulder,
+    kJointRElbow,
+    kJointRWrist,
+    kJointRHand,
+
+    kJointLHip,
+    kJointLKnee,
+    kJointLAnkle,
+    kJointLFoot,
+
+    kJointRHip,
+    kJointRKnee,
+    kJointRAnkle,
+    kJointRFoot,
+
+    kJointCShoulder,
+    kJointLHandTip,
+    kJointLThumb,
+    kJointRHandTip,
+    kJointRThumb,
+
+    kNumJoints
+};
+
+// joint masks have bit j set for joint j
+static const uint32_t kAllJoints = (1u << kNumJoints) - 1;
+
+// joint names as sent by the tracker, indexed by JointIndex
+static const char* const kJointNames[kNumJoints] = {
+    "waist", "torso", "neck", "head",
+    "l_shoulder", "l_elbow", "l_wrist", "l_hand",
+    "r_shoulder", "r_elbow", "r_wrist", "r_hand",
+    "l_hip", "l_knee", "l_ankle", "l_foot",
+    "r_hip", "r_knee", "r_ankle", "r_foot",
+    "c_shoulder", "l_hand_tip", "l_thumb", "r_hand_tip", "r_thumb"
+};
+
+// returns JointIndex for name, or -1 if unknown
+inline int jointIndex(const string& name) {
+    for(int i=0; i<kNumJoints; i++) if(name == kJointNames[i]) return i;
+    return -1;
+}
+
+
+// joint hierarchy, parsed once from joints.xml and shared (read only) by everyone
+struct JointSchema {
+    int parents[kNumJoints];    // index of the parent joint of each joint, for vec
+
+    // loaded on first use
+    static const JointSchema& get() {
+        static const JointSchema schema("joints.xml");
+        return schema;
+    }
+
+private:
+    JointSchema(const string& filename) {
+        for(int i=0; i<kNumJoints; i++) parents[i] = i;
+
+        ofXml xml;
+        if(!xml.load(filename)) {
+            ofLogError() << "JointSchema could not load " << filename;
+            return;
+        }
+        xml.setTo("//JointInfo");
+
+        for(int i=0; i<kNumJoints; i++) {
+            string jointName = xml.getValue<string>("JointNames/joint[" + ofToString(i) + "]");
+            string parentName = xml.getValue<string>("JointParents/parent[" + ofToString(i) + "]");
+            int index = jointIndex(jointName);
+            int parent = jointIndex(parentName);
+            if(index < 0 || parent < 0) {
+                ofLogError() << "JointSchema unknown joint in " << filename << " " << jointName << " -> " << parentName;
+                continue;
+            }
+            parents[index] = parent;
+        }
+    }
+};
+
+
+// smoothing, springs and frame counts are tuned per frame at this rate, and scaled to whatever rate they run at
+static const int kReferenceFps = 30;
+
+// smoothing per frame at kReferenceFps -> smoothing for one step of dt seconds
+inline float rateSmoothing(float smoothing, float dt) { return powf(smoothing, dt * kReferenceFps); }
+
+// cur += (target - cur) * (1 - smoothing), n floats
+inline void smoothArray(float* __restrict cur, const float* __restrict target, int n, float smoothing) {
+    float k = 1 - smoothing;
+    for(int i=0; i<n; i++) cur[i] += (target[i] - cur[i]) * k;
+}
+
+// springy_vel = springy_vel * (1 - damping) + (target - springy_pos) * strength
+// springy_pos += springy_vel, n floats
+// strength and damping are per frame at kReferenceFps, steps is how many of those frames to advance (dt * kReferenceFps)
+inline void springArray(float* __restrict pos, float* __restrict vel, const float* __restrict target, int n, float strength, float damping, float steps = 1) {
+    float d = powf(1 - damping, steps);
+    float s = strength * steps;
+    for(int i=0; i<n; i++) {
+        vel[i] = vel[i] * d + (target[i] - pos[i]) * s;
+        pos[i] += vel[i] * steps;
+    }
+}
+
+// out[i] = |v[i]|
+inline void lengthArray(float* __restrict out, const ofVec3f* __restrict v, int n) {
+    for(int i=0; i<n; i++) out[i] = sqrtf(v[i].x * v[i].x + v[i].y * v[i].y + v[i].z * v[i].z);
+}
+
+// vec[i] = pos[parents[i]] - pos[i]
+inline void parentVectorArray(ofVec3f* __restrict vec, const ofVec3f* __restrict pos, const int* __restrict parents, int n) {
+    for(int i=0; i<n; i++) vec[i] = pos[parents[i]] - pos[i];
+}
+
+// out[i] = (in[i], w) * m, i.e. same as ofVec4f(in[i], w) * m. use w = 1 for points and w = 0 for directions
+inline void transformArray(ofVec3f* __restrict out, const ofVec3f* __restrict in, const ofMatrix4x4& matrix, float w, int n) {
+    const float* m = matrix.getPtr();
+    float tx = m[12] * w, ty = m[13] * w, tz = m[14] * w;
+    for(int i=0; i<n; i++) {
+        float x = in[i].x, y = in[i].y, z = in[i].z;
+        out[i].x = x * m[0] + y * m[4] + z * m[8]  + tx;
+        out[i].y = x * m[1] + y * m[5] + z * m[9]  + ty;
+        out[i].z = x * m[2] + y * m[6] + z * m[10] + tz;
+    }
+}
+
+}
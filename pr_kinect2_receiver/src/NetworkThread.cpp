@@ -0,0 +1,230 @@
+
+#include "NetworkThread.h"
+#include "PacketLog.h"
+
+#ifdef TARGET_LINUX
+#include <sys/epoll.h>
+#endif
+
+namespace pr {
+
+// max datagrams read per recvmmsg call
+#define kReceiveBatch   16
+
+// how long to block waiting for datagrams, so add() / remove() / stop() are picked up
+#define kWaitMillis     10
+
+
+NetworkThread::~NetworkThread() {
+    stop();
+#ifdef TARGET_LINUX
+    if(epoll_fd >= 0) close(epoll_fd);
+#endif
+}
+
+
+void NetworkThread::start() {
+    if(isThreadRunning()) return;
+#ifdef TARGET_LINUX
+    if(epoll_fd < 0) epoll_fd = epoll_create1(0);
+#endif
+    startThread();
+}
+
+
+void NetworkThread::stop() {
+    if(!isThreadRunning()) return;
+    stopThread();
+    waitForThread(false);
+}
+
+
+bool NetworkThread::add(int port, PacketQueue* queue) {
+    unique_ptr<DatagramSocket> socket(new DatagramSocket());
+    if(!socket->bind(port)) return false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    Listener listener;
+    listener.id = next_id++;
+    listener.port = port;
+    listener.queue = queue;
+
+#ifdef TARGET_LINUX
+    if(epoll_fd < 0) epoll_fd = epoll_create1(0);
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = listener.id;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket->getHandle(), &ev);
+#endif
+
+    listener.socket = std::move(socket);
+    listeners.push_back(std::move(listener));
+    ofLogNotice() << "NetworkThread::add listening on port " << port;
+    return true;
+}
+
+
+void NetworkThread::remove(PacketQueue* queue) {
+    // the network thread holds the mutex while it touches any queue
+    std::unique_lock<std::mutex> lock(mutex);
+    for(auto it = listeners.begin(); it != listeners.end(); ) {
+        if(it->queue == queue) {
+#ifdef TARGET_LINUX
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->socket->getHandle(), NULL);
+#endif
+            ofLogNotice() << "NetworkThread::remove closing port " << it->port;
+            it = listeners.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+
+void NetworkThread::setRecorder(PacketRecorder* r) {
+    std::unique_lock<std::mutex> lock(mutex);
+    recorder = r;
+}
+
+
+void NetworkThread::setLive(bool l) {
+    live = l;
+}
+
+
+bool NetworkThread::inject(int port, const char* data, int size, uint64_t arrival_micros) {
+    std::unique_lock<std::mutex> lock(mutex);
+    for(auto&& listener : listeners) {
+        if(listener.port != port) continue;
+        PacketQueue& queue = *listener.queue;
+        Packet* packet = queue.beginWrite();
+        if(!packet) {
+            queue.num_dropped++;
+            return true;
+        }
+        packet->size = min(size, int(Packet::kMaxSize));
+        packet->arrival_micros = arrival_micros;
+        memcpy(packet->data, data, packet->size);
+        queue.commit();
+        return true;
+    }
+    return false;
+}
+
+
+NetworkThread::Listener* NetworkThread::findListener(int id) {
+    for(auto&& listener : listeners) if(listener.id == id) return &listener;
+    return NULL;
+}
+
+
+void NetworkThread::threadedFunction() {
+    while(isThreadRunning()) {
+#ifdef TARGET_LINUX
+        // wait without holding the mutex, ids of removed listeners simply won't be found afterwards
+        epoll_event events[32];
+        int n = epoll_wait(epoll_fd, events, 32, kWaitMillis);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        for(int i=0; i<n; i++) {
+            Listener* listener = findListener(events[i].data.u32);
+            if(listener) receive(*listener);
+        }
+#else
+        fd_set fds;
+        FD_ZERO(&fds);
+        int max_fd = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            for(auto&& listener : listeners) {
+                FD_SET(listener.socket->getHandle(), &fds);
+                max_fd = max(max_fd, (int)listener.socket->getHandle());
+            }
+        }
+
+        timeval timeout = { 0, kWaitMillis * 1000 };
+        int n = select(max_fd + 1, &fds, NULL, NULL, &timeout);
+        if(n <= 0) {
+            // select fails straight away with no sockets on windows
+            if(n < 0) ofSleepMillis(kWaitMillis);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        for(auto&& listener : listeners) {
+            if(FD_ISSET(listener.socket->getHandle(), &fds)) receive(listener);
+        }
+#endif
+    }
+}
+
+
+void NetworkThread::receive(Listener& listener) {
+    PacketQueue& queue = *listener.queue;
+    DatagramSocket& socket = *listener.socket;
+
+    // throwaway slot for when the queue is full (or we're not live), so the kernel buffer doesn't fill up with stale data
+    static Packet overflow;
+    bool discard = !live;
+
+#ifdef TARGET_LINUX
+    mmsghdr msgs[kReceiveBatch];
+    iovec iovecs[kReceiveBatch];
+
+    while(true) {
+        // point the batch at the free slots of the queue
+        int count = 0;
+        Packet* packets[kReceiveBatch];
+        for(; count < kReceiveBatch; count++) {
+            packets[count] = queue.beginWrite(count);
+            if(!packets[count]) break;
+        }
+        if(discard) count = 0;
+        bool full = count == 0;
+        if(full) packets[count++] = &overflow;
+
+        for(int i=0; i<count; i++) {
+            iovecs[i].iov_base = packets[i]->data;
+            iovecs[i].iov_len = Packet::kMaxSize;
+            memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n = recvmmsg(socket.getHandle(), msgs, count, MSG_DONTWAIT, NULL);
+        if(n <= 0) return;
+
+        uint64_t now = ofGetElapsedTimeMicros();
+        if(discard) continue;
+        for(int i=0; i<n; i++) {
+            Packet* packet = packets[i];
+            packet->size = msgs[i].msg_len;
+            packet->arrival_micros = now;
+            if(recorder) recorder->add(listener.port, *packet, full);
+        }
+        if(full) queue.num_dropped += n;
+        else queue.commit(n);
+
+        // socket is drained
+        if(n < count) return;
+    }
+#else
+    while(true) {
+        Packet* packet = discard ? NULL : queue.beginWrite();
+        bool full = packet == NULL;
+        if(full) packet = &overflow;
+
+        int size = socket.receive(packet->data, Packet::kMaxSize);
+        if(size <= 0) return;
+        if(discard) continue;
+
+        packet->size = size;
+        packet->arrival_micros = ofGetElapsedTimeMicros();
+        if(recorder) recorder->add(listener.port, *packet, full);
+        if(full) queue.num_dropped++;
+        else queue.commit();
+    }
+#endif
+}
+
+}
@@ -0,0 +1,108 @@
+/*
+ One thread that receives the datagrams for all Receivers
+ - waits on all sockets at once (epoll on linux, select elsewhere)
+ - reads them in batches (recvmmsg on linux) straight into preallocated packet queues
+ - Receivers pick the packets up from their queue on the processing thread, without locking
+ - can record everything that comes in, and be switched off the sockets to have a replay injected instead (see PacketLog.h)
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "DatagramSocket.h"
+
+namespace pr {
+
+class PacketRecorder;
+
+// one received datagram
+struct Packet {
+    static const int kMaxSize = 65536;  // biggest datagram we can receive
+
+    int size = 0;
+    uint64_t arrival_micros = 0;        // ofGetElapsedTimeMicros() when it was received
+    char data[kMaxSize];
+};
+
+
+// fixed size ring of packets, for exactly one producer (the network thread) and one consumer
+class PacketQueue {
+public:
+    // capacity must be a power of two
+    PacketQueue(int capacity) : slots(capacity), mask(capacity - 1) {}
+
+    // producer: slot to write into, NULL if full. the packet is only visible to the consumer after commit()
+    Packet* beginWrite(int i = 0) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if(h + i - tail.load(std::memory_order_acquire) >= slots.size()) return NULL;
+        return &slots[(h + i) & mask];
+    }
+    void commit(int count = 1) { head.fetch_add(count, std::memory_order_release); }
+
+    // consumer: oldest packet, NULL if empty. stays valid until pop()
+    const Packet* front() const {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if(t == head.load(std::memory_order_acquire)) return NULL;
+        return &slots[t & mask];
+    }
+    void pop() { tail.fetch_add(1, std::memory_order_release); }
+
+    int size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    int capacity() const { return slots.size(); }
+
+    atomic<int> num_dropped { 0 };      // packets thrown away because the queue was full
+
+private:
+    vector<Packet> slots;
+    uint32_t mask;
+    atomic<uint32_t> head { 0 };        // next slot to write
+    atomic<uint32_t> tail { 0 };        // next slot to read
+};
+
+
+class NetworkThread : public ofThread {
+public:
+    ~NetworkThread();
+
+    void start();
+    void stop();
+
+    // start receiving datagrams on port into queue. returns false if the port couldn't be bound
+    bool add(int port, PacketQueue* queue);
+
+    // stop receiving into queue. once this returns the network thread doesn't touch queue anymore
+    void remove(PacketQueue* queue);
+
+    // every datagram received from now on also goes to recorder, NULL to stop
+    void setRecorder(PacketRecorder* recorder);
+
+    // when not live, whatever arrives on the sockets is thrown away, only inject() fills the queues
+    void setLive(bool live);
+    bool isLive() const     { return live; }
+
+    // a datagram for whoever listens on port, as if it had arrived at arrival_micros. returns false if no one does
+    bool inject(int port, const char* data, int size, uint64_t arrival_micros);
+
+protected:
+    struct Listener {
+        int id;
+        int port;
+        PacketQueue* queue;
+        unique_ptr<DatagramSocket> socket;
+    };
+
+    vector<Listener> listeners;     // guarded by mutex
+    int next_id = 0;
+    PacketRecorder* recorder = NULL;    // guarded by mutex
+    atomic<bool> live { true };
+
+#ifdef TARGET_LINUX
+    int epoll_fd = -1;
+#endif
+
+    void threadedFunction() override;
+    void receive(Listener& listener);
+    Listener* findListener(int id);
+};
+
+}
@@ -0,0 +1,224 @@
+/*
+ Writes the output persons as an OSC bundle straight into a fixed buffer, without allocating
+ - the address and type tags of every message are built once in setup(), a message is then a memcpy and its floats
+ - per joint (default): /skel/<i>/<joint>  the selected fields, in the order of OscField (all: 23 floats, pos xyz, quat xyzw, euler xyz, vel xyz, speed, vec xyz, springy_pos xyz, springy_vel xyz)
+ - packed: /skel/<i>  one blob per person, the same floats for each of the selected joints in JointIndex order (big endian, like all OSC)
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "Person.h"
+
+namespace pr {
+
+// what gets sent of each joint, as bits of a mask
+enum OscField {
+    kFieldPos           = 1 << 0,   // 3 floats
+    kFieldQuat          = 1 << 1,   // 4
+    kFieldEuler         = 1 << 2,   // 3
+    kFieldVel           = 1 << 3,   // 3
+    kFieldSpeed         = 1 << 4,   // 1
+    kFieldVec           = 1 << 5,   // 3
+    kFieldSpringyPos    = 1 << 6,   // 3
+    kFieldSpringyVel    = 1 << 7,   // 3
+    kNumFields          = 8,
+    kAllFields          = (1 << kNumFields) - 1
+};
+
+static const char* const kFieldNames[kNumFields] = { "pos", "quat", "euler", "vel", "speed", "vec", "springy_pos", "springy_vel" };
+static const int kFieldSizes[kNumFields] = { 3, 4, 3, 3, 1, 3, 3, 3 };
+
+
+class OscEncoder {
+public:
+    static const int kMaxPersons = 16;              // persons we have addresses for
+    static const int kBufferSize = 65507;           // biggest UDP datagram
+
+    OscEncoder() { setup(kAllFields, kAllJoints); }
+
+    // fields: OscField mask, joints: joint mask. builds all the headers
+    void setup(int fields, uint32_t joints) {
+        this->fields = fields;
+        this->joints = joints & kAllJoints;
+
+        num_floats = 0;
+        for(int f=0; f<kNumFields; f++) if(fields & (1 << f)) num_floats += kFieldSizes[f];
+        num_joints = 0;
+        for(int j=0; j<kNumJoints; j++) if(this->joints & (1u << j)) num_joints++;
+
+        headers.clear();
+        char address[64];
+        for(int i=0; i<kMaxPersons; i++) {
+            for(int j=0; j<kNumJoints; j++) {
+                snprintf(address, sizeof(address), "/skel/%d/%s", i, kJointNames[j]);
+                joint_headers[i][j] = addHeader(address, string(",") + string(num_floats, 'f'));
+            }
+            snprintf(address, sizeof(address), "/skel/%d", i);
+            packed_headers[i] = addHeader(address, ",b");
+        }
+        meta_header = addHeader("/meta", ",i");
+    }
+
+    int getFields() const       { return fields; }
+    uint32_t getJoints() const  { return joints; }
+
+    // starts a new bundle, to be sent immediately
+    void begin() {
+        memcpy(buffer, "#bundle\0", 8);
+        writeInt(buffer + 8, 0);
+        writeInt(buffer + 12, 1);
+        size = 16;
+    }
+
+    // /meta num_persons
+    bool addMeta(int num_persons) {
+        char* p = beginMessage(meta_header, 4);
+        if(!p) return false;
+        writeInt(p, num_persons);
+        return true;
+    }
+
+    // the selected joints of the person at output index i. per joint, only the ones also in changed get a message
+    // (packed always has all of them, as long as any changed). returns false if the bundle is too full, then nothing has been added.
+    // i must be below kMaxPersons, there are no addresses for any more
+    bool addPerson(int i, const Person& person, bool packed, uint32_t changed = kAllJoints) {
+        if(i < 0 || i >= kMaxPersons) {
+            ofLogError() << "OscEncoder::addPerson no addresses for person " << i;
+            return false;
+        }
+        const Joints& person_joints = person.joints;
+
+        if(packed) {
+            if(!(changed & joints)) return true;
+            int blob_size = num_joints * num_floats * 4;
+            char* p = beginMessage(packed_headers[i], 4 + blob_size);
+            if(!p) return false;
+            writeInt(p, blob_size);
+            p += 4;
+            for(int j=0; j<kNumJoints; j++) if(joints & (1u << j)) p = writeJoint(p, person_joints, j);
+        } else {
+            uint32_t send = changed & joints;
+
+            // all or nothing, so a person is never split across bundles
+            int needed = 0;
+            for(int j=0; j<kNumJoints; j++) if(send & (1u << j)) needed += 4 + joint_headers[i][j].size + num_floats * 4;
+            if(size + needed > kBufferSize) return false;
+            for(int j=0; j<kNumJoints; j++) if(send & (1u << j)) writeJoint(beginMessage(joint_headers[i][j], num_floats * 4), person_joints, j);
+        }
+        return true;
+    }
+
+    // any other message of n floats, e.g. /stats. the header is written as it goes, for the occasional message
+    bool addFloats(const char* address, const float* values, int n) {
+        int address_size = padded(strlen(address));
+        int tags_size = padded(n + 1);
+        int element_size = address_size + tags_size + n * 4;
+        if(size + 4 + element_size > kBufferSize) return false;
+        char* p = buffer + size;
+        writeInt(p, element_size);
+        p += 4;
+        memset(p, 0, address_size + tags_size);
+        memcpy(p, address, strlen(address));
+        p += address_size;
+        p[0] = ',';
+        memset(p + 1, 'f', n);
+        p += tags_size;
+        for(int i=0; i<n; i++) p = writeFloat(p, values[i]);
+        size += 4 + element_size;
+        return true;
+    }
+
+    // true if nothing has been added since begin()
+    bool isEmpty() const        { return size <= 16; }
+
+    const char* getData() const { return buffer; }
+    int getSize() const         { return size; }
+
+private:
+    struct Header {
+        int offset;
+        int size;
+    };
+
+    int fields = kAllFields;
+    uint32_t joints = kAllJoints;
+    int num_floats = 0;     // per joint
+    int num_joints = 0;
+
+    // all the precomputed address + type tag strings, back to back
+    vector<char> headers;
+    Header joint_headers[kMaxPersons][kNumJoints];
+    Header packed_headers[kMaxPersons];
+    Header meta_header;
+
+    char buffer[kBufferSize];
+    int size = 0;
+
+    Header addHeader(const string& address, const string& tags) {
+        Header header;
+        header.offset = headers.size();
+        addPadded(address);
+        addPadded(tags);
+        header.size = headers.size() - header.offset;
+        return header;
+    }
+
+    // OSC strings are null terminated and padded to a multiple of 4
+    void addPadded(const string& s) {
+        headers.insert(headers.end(), s.begin(), s.end());
+        headers.resize(headers.size() + padded(s.size()) - s.size(), 0);
+    }
+
+    static int padded(int length)   { return length + 4 - length % 4; }
+
+    // bundle element size, then the header. returns where the arguments go, NULL if they wouldn't fit
+    char* beginMessage(const Header& header, int args_size) {
+        int element_size = header.size + args_size;
+        if(size + 4 + element_size > kBufferSize) return NULL;
+        char* p = buffer + size;
+        writeInt(p, element_size);
+        memcpy(p + 4, headers.data() + header.offset, header.size);
+        size += 4 + element_size;
+        return p + 4 + header.size;
+    }
+
+    char* writeJoint(char* p, const Joints& joints, int j) const {
+        if(fields & kFieldPos) p = write3(p, joints.pos[j]);
+        if(fields & kFieldQuat) {
+            p = writeFloat(p, joints.quat[j]._v.x);
+            p = writeFloat(p, joints.quat[j]._v.y);
+            p = writeFloat(p, joints.quat[j]._v.z);
+            p = writeFloat(p, joints.quat[j]._v.w);
+        }
+        if(fields & kFieldEuler) p = write3(p, joints.euler[j]);
+        if(fields & kFieldVel) p = write3(p, joints.vel[j]);
+        if(fields & kFieldSpeed) p = writeFloat(p, joints.speed[j]);
+        if(fields & kFieldVec) p = write3(p, joints.vec[j]);
+        if(fields & kFieldSpringyPos) p = write3(p, joints.springy_pos[j]);
+        if(fields & kFieldSpringyVel) p = write3(p, joints.springy_vel[j]);
+        return p;
+    }
+
+    static char* write3(char* p, const ofVec3f& v) {
+        p = writeFloat(p, v.x);
+        p = writeFloat(p, v.y);
+        return writeFloat(p, v.z);
+    }
+
+    static char* writeFloat(char* p, float f) {
+        uint32_t u;
+        memcpy(&u, &f, 4);
+        writeInt(p, u);
+        return p + 4;
+    }
+
+    static void writeInt(char* p, uint32_t u) {
+        p[0] = u >> 24;
+        p[1] = u >> 16;
+        p[2] = u >> 8;
+        p[3] = u;
+    }
+};
+
+}
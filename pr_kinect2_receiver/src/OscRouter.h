@@ -0,0 +1,167 @@
+/*
+ Maps incoming OSC addresses straight to a message type (and joint index / user id)
+ The tracker's address space is compiled into a small trie of address parts at startup,
+ routing a message walks the address in place without allocating.
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "Joints.h"
+
+namespace pr {
+
+struct OscRoute {
+    enum Type {
+        kUnknown,
+        kSkel,          // /skel/<id>/<joint>           x y z conf qx qy qz qw vx vy vz speed
+        kNewUser,       // /new_user                    id
+        kLostUser,      // /lost_user                   id
+        kCalib,         // /calib_success               id
+        kUser,          // /user/<id>                   x y z q
+        kRestricted,    // /restricted/<id>             is_restricted conf
+        kHandLeft,      // /handstate/<id>/left         state conf
+        kHandRight,     // /handstate/<id>/right        state conf
+        kLean,          // /lean/<id>                   x y conf
+        kFloorPlane,    // /floorplane                  x y z w
+        kAppearance,    // /appearance/<id>             sampleCount histogram
+        kFrame,         // /frame                       frameId captureMicros
+        kNumTypes
+    };
+
+    Type type = kUnknown;
+    int user_id = -1;   // <id> from the address, -1 if there is none
+    int joint = -1;     // JointIndex for kSkel, -1 otherwise
+};
+
+
+class OscRouter {
+public:
+    OscRouter() {
+        nodes.push_back(Node());    // root
+
+        for(int j=0; j<kNumJoints; j++) add(string("/skel/#/") + kJointNames[j], OscRoute::kSkel, j);
+        add("/new_user", OscRoute::kNewUser);
+        add("/lost_user", OscRoute::kLostUser);
+        add("/calib_success", OscRoute::kCalib);
+        add("/user/#", OscRoute::kUser);
+        add("/restricted/#", OscRoute::kRestricted);
+        add("/handstate/#/left", OscRoute::kHandLeft);
+        add("/handstate/#/right", OscRoute::kHandRight);
+        add("/lean/#", OscRoute::kLean);
+        add("/floorplane", OscRoute::kFloorPlane);
+        add("/appearance/#", OscRoute::kAppearance);
+        add("/frame", OscRoute::kFrame);
+    }
+
+    // finds the route for address. returns false if the address isn't known
+    bool route(const char* address, OscRoute& route) const {
+        route = OscRoute();
+        if(!address || *address != '/') return false;
+
+        int node = 0;
+        const char* p = address;
+        while(*p == '/') {
+            // find end of this address part
+            const char* part = ++p;
+            while(*p && *p != '/') p++;
+            int len = p - part;
+
+            int next = -1;
+            const Node& n = nodes[node];
+            for(int c = n.first_child; c >= 0; c = nodes[c].next_sibling) {
+                const Node& child = nodes[c];
+                if(child.is_id) {
+                    int id;
+                    if(parseId(part, len, id)) { route.user_id = id; next = c; break; }
+                } else if(child.name.size() == len && memcmp(child.name.data(), part, len) == 0) {
+                    next = c;
+                    break;
+                }
+            }
+            if(next < 0) return false;
+            node = next;
+        }
+        if(*p != 0 || nodes[node].type == OscRoute::kUnknown) return false;
+
+        route.type = nodes[node].type;
+        route.joint = nodes[node].joint;
+        return true;
+    }
+
+    // OSC type tags each message type must start with (extra trailing arguments are allowed)
+    static const char* typeTags(OscRoute::Type type) {
+        static const char* tags[OscRoute::kNumTypes] = {
+            "",             // kUnknown
+            "fffffffffff",  // kSkel (speed is optional, we don't read it)
+            "i",            // kNewUser
+            "i",            // kLostUser
+            "i",            // kCalib
+            "fff",          // kUser
+            "i",            // kRestricted
+            "s",            // kHandLeft
+            "s",            // kHandRight
+            "fff",          // kLean
+            "ffff",         // kFloorPlane
+            "ib",           // kAppearance
+            "ih"            // kFrame
+        };
+        return tags[type];
+    }
+
+    // true if typeTags (as in the message) match what type expects
+    static bool validate(OscRoute::Type type, const char* tags) {
+        const char* expected = typeTags(type);
+        if(!tags) return *expected == 0;
+        while(*expected) if(*tags++ != *expected++) return false;
+        return true;
+    }
+
+private:
+    struct Node {
+        string name;        // address part to match (unused if is_id)
+        bool is_id = false; // matches an integer address part
+        int first_child = -1;
+        int next_sibling = -1;
+        OscRoute::Type type = OscRoute::kUnknown;
+        int joint = -1;
+    };
+
+    vector<Node> nodes;
+
+    // only used while building, at startup
+    void add(const string& address, OscRoute::Type type, int joint = -1) {
+        int node = 0;
+        for(auto&& part : ofSplitString(address.substr(1), "/")) {
+            bool is_id = part == "#";
+            int found = -1;
+            for(int c = nodes[node].first_child; c >= 0; c = nodes[c].next_sibling) {
+                if(nodes[c].is_id == is_id && nodes[c].name == part) { found = c; break; }
+            }
+            if(found < 0) {
+                Node child;
+                child.name = part;
+                child.is_id = is_id;
+                child.next_sibling = nodes[node].first_child;
+                nodes.push_back(child);
+                found = nodes.size() - 1;
+                nodes[node].first_child = found;
+            }
+            node = found;
+        }
+        nodes[node].type = type;
+        nodes[node].joint = joint;
+    }
+
+    static bool parseId(const char* s, int len, int& id) {
+        if(len <= 0 || len > 9) return false;
+        id = 0;
+        for(int i=0; i<len; i++) {
+            if(s[i] < '0' || s[i] > '9') return false;
+            id = id * 10 + (s[i] - '0');
+        }
+        return true;
+    }
+};
+
+}
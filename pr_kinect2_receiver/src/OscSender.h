@@ -1,17 +1,37 @@
+/*
+ One OSC output profile: where to, what (fields, joints, packed), how often (rate), and only what moved (deadband)
+ as many as there are <output>s in <Outputs> in settings, all fed the same persons every tick
+ */
+
 #pragma once
 
-#include "ofxOscSender.h"
+#include "DatagramSocket.h"
+#include "OscEncoder.h"
+#include "Telemetry.h"
+
+#ifndef PR_HEADLESS
 #include "ofxImGui.h"
+#endif
 
 
 namespace pr {
 
 class OscSender {
 public:
+    typedef shared_ptr<OscSender> Ptr;
+
+    // with a deadband, everything is still sent this often, so anyone who missed something catches up
+    static constexpr float kRefreshInterval = 1.0;
+
+    string name = "main";
     bool enabled = true;
-    int host_port;
-    string host_ip;
-    ofxOscSender osc_sender;
+    bool packed = false;    // one blob per person instead of one message per joint, see OscEncoder
+    int host_port = 0;
+    string host_ip = "127.0.0.1";
+    float rate = 0;         // sends per second, 0 to send every tick
+    float deadband = 0;     // joints that moved less than this (m) since they were last sent are left out. 0 sends all of them.
+                            // rotations (if quat or euler are sent) count as deadband radians, i.e. deadband m at 1m from the joint
+    bool stats = false;     // also send /stats every Telemetry::interval, see Telemetry.h
 
 
     void setup(string s, int p) {
@@ -21,43 +41,279 @@ public:
 	}
 
     void init() {
-        osc_sender.setup(host_ip, host_port);
+        socket.connect(host_ip, host_port);
+    }
+
+    // OscField mask / joint mask of what to send. no fields at all would send empty messages, that's kept as it was
+    void setFormat(int fields, uint32_t joints) {
+        if(!(fields & kAllFields)) {
+            ofLogError() << "OscSender::setFormat no fields for output " << name << ", keeping " << fieldsToString(encoder.getFields());
+            fields = encoder.getFields();
+        }
+        encoder.setup(fields, joints);
+    }
+
+    // /meta with the number of persons, then their joints. usually one datagram, more if they don't all fit.
+    // any more than OscEncoder::kMaxPersons are left out (Reducer::kMaxSlots never makes more).
+    // call every tick (dt seconds), whatever the rate
+    void sendPersons(const vector<Person::Ptr>& persons, float dt) {
+        if(!enabled || !host_port) return;
+
+        // not due yet. within half a tick counts as due, so e.g. 15 of 30 ticks is every other one
+        if(rate > 0) {
+            if(send_timer > dt * 0.5f) {
+                send_timer -= dt;
+                return;
+            }
+            send_timer = max(send_timer + 1 / rate - dt, 0.0f);
+        }
+
+        refresh_timer -= rate > 0 ? 1 / rate : dt;
+        bool refresh = deadband <= 0 || refresh_timer <= 0;
+        if(refresh_timer <= 0) refresh_timer = kRefreshInterval;
+
+        uint64_t start = Telemetry::nanos();
+        send_nanos = 0;
+
+        int num_persons = min<int>(persons.size(), OscEncoder::kMaxPersons);
+        encoder.begin();
+        encoder.addMeta(num_persons);
+        int meta_size = encoder.getSize();
+        for(int i=0; i<num_persons; i++) {
+            if(!persons[i]) continue;
+            const Person& person = *persons[i];
+            uint32_t changed = refresh ? kAllJoints : changedJoints(i, person);
+            if(!encoder.addPerson(i, person, packed, changed)) {
+                flush();
+                encoder.begin();
+                if(!encoder.addPerson(i, person, packed, changed)) {
+                    // too big for a datagram of its own. last_sent stays, so the deadband still sees these joints as unsent
+                    if(!logged_too_big) ofLogError() << "OscSender::sendPersons " << name << ": person " << i << " doesn't fit in a datagram, not sent";
+                    logged_too_big = true;
+                    continue;
+                }
+            }
+
+            // packed sends all of them if any
+            if(packed && (changed & encoder.getJoints())) changed = kAllJoints;
+            for(int j=0; j<kNumJoints; j++) {
+                if(!(changed & (1u << j))) continue;
+                last_sent[i][j] = person.joints.pos[j];
+                last_sent_quat[i][j] = person.joints.quat[j];
+            }
+        }
+
+        // nothing moved and nobody came or went, don't bother sending the /meta on its own
+        bool unchanged = !refresh && num_persons == last_num_persons && encoder.getSize() == meta_size;
+        last_num_persons = num_persons;
+        if(!unchanged) flush();
+
+        // flush() times the sending itself
+        Telemetry::get().addTime(kStageEncode, Telemetry::nanos() - start - send_nanos);
+    }
+
+    // the telemetry summary, on its own. not rate limited
+    void sendStats(const float* values, int n) {
+        if(!enabled || !host_port || !stats) return;
+        encoder.begin();
+        if(encoder.addFloats("/stats", values, n)) flush();
+    }
+
+    // what the gui edits (see Pipeline::drawGui)
+    struct Params {
+        bool enabled;
+        int port;
+        bool packed;
+        float rate;
+        float deadband;
+        bool stats;
+        unsigned int fields;
+    };
+
+    Params getParams() const {
+        Params params;
+        params.enabled = enabled;
+        params.port = host_port;
+        params.packed = packed;
+        params.rate = rate;
+        params.deadband = deadband;
+        params.stats = stats;
+        params.fields = encoder.getFields();
+        return params;
+    }
+
+    // reopens the socket / changes the format only if they changed
+    void setParams(const Params& params) {
+        enabled = params.enabled;
+        packed = params.packed;
+        rate = params.rate;
+        deadband = params.deadband;
+        stats = params.stats;
+        if(params.port != host_port) {
+            host_port = params.port;
+            init();
+        }
+        if((int)params.fields != encoder.getFields()) setFormat(params.fields, encoder.getJoints());
     }
 
-    void sendBundle(ofxOscBundle& b) {
-        if(enabled && host_port) osc_sender.sendBundle(b);
+#ifndef PR_HEADLESS
+    string getStatus() const {
+        stringstream str;
+        str << "To: " << host_ip << ":" << host_port << ", joints: " << jointsToString(encoder.getJoints()) << endl;
+        str << "Sent: " << num_datagrams << " datagrams, " << num_bytes / 1024 << "KB";
+        return str.str();
     }
 
-    void drawGui() {
-        ImGui::CollapsingHeader("OscSender", NULL, true, true);
-        ImGui::Checkbox("Enabled", &enabled);
+    // no sender needed. true if params changed
+    static bool drawGui(const string& name, Params& params, const string& status) {
+        string suffix = " (" + name + ")";
+        bool changed = false;
+        ImGui::CollapsingHeader(("Output " + name).c_str(), NULL, true, true);
+        changed |= ImGui::Checkbox(("Enabled" + suffix).c_str(), &params.enabled);
         //ImGui::InputText("Host ip", hostIp.c_str(), )
-        ImGui::InputInt("Port", &host_port, 1, 100);
+        changed |= ImGui::InputInt(("Port" + suffix).c_str(), &params.port, 1, 100);
+        changed |= ImGui::Checkbox(("Packed" + suffix).c_str(), &params.packed);
+        changed |= ImGui::SliderFloat(("Rate (0 every tick)" + suffix).c_str(), &params.rate, 0, 120);
+        changed |= ImGui::SliderFloat(("Deadband" + suffix).c_str(), &params.deadband, 0, 0.1, "%.4f");
+        changed |= ImGui::Checkbox(("Stats" + suffix).c_str(), &params.stats);
+        for(int f=0; f<kNumFields; f++) {
+            if(f % 4) ImGui::SameLine();
+            changed |= ImGui::CheckboxFlags((kFieldNames[f] + suffix).c_str(), &params.fields, 1 << f);
+        }
+        ImGui::Text(status.c_str());
+        return changed;
     }
+#endif
 
 
+    // from the current element, an <output> (or the old <Sender>)
     void loadFromXml(ofXml& xml) {
-		xml.setTo("//Settings/Sender");
+		if (xml.exists("name")) name = xml.getValue<string>("name");
+		if (xml.exists("enabled")) enabled = xml.getBoolValue("enabled");
 		if (host_port != xml.getIntValue("port") || host_ip != xml.getValue<string>("ipAddress")) {
 			host_port = xml.getIntValue("port");
 			host_ip = xml.getValue<string>("ipAddress");
 			init();
 		}
+		packed = xml.exists("packed") && xml.getBoolValue("packed");
+		rate = xml.exists("rate") ? xml.getFloatValue("rate") : 0;
+		deadband = xml.exists("deadband") ? xml.getFloatValue("deadband") : 0;
+		stats = xml.exists("stats") && xml.getBoolValue("stats");
+		setFormat(xml.exists("fields") ? fieldsFromString(xml.getValue<string>("fields")) : kAllFields,
+				  xml.exists("joints") ? jointsFromString(xml.getValue<string>("joints")) : kAllJoints);
     }
 
-    void saveToXml(ofXml& xml) {
-        // save ip and port to xml
-		xml.setTo("//Settings");
-		xml.addChild("Sender");
-		xml.setTo("Sender");
+    // into the current element
+    void saveToXml(ofXml& xml) const {
+		xml.addValue("name", name);
+		xml.addValue("enabled", ofToString(enabled));
 		xml.addValue("port", ofToString(host_port));
 		xml.addValue("ipAddress", host_ip);
+		xml.addValue("packed", ofToString(packed));
+		xml.addValue("fields", fieldsToString(encoder.getFields()));
+		xml.addValue("joints", jointsToString(encoder.getJoints()));
+		xml.addValue("rate", ofToString(rate));
+		xml.addValue("deadband", ofToString(deadband));
+		xml.addValue("stats", ofToString(stats));
+    }
+
 
+    // "all", or names separated by spaces or commas
+    static int fieldsFromString(const string& s) {
+        int fields = 0;
+        for(auto&& token : splitNames(s)) {
+            if(token == "all") return kAllFields;
+            int f = 0;
+            while(f < kNumFields && token != kFieldNames[f]) f++;
+            if(f < kNumFields) fields |= 1 << f;
+            else ofLogError() << "OscSender::fieldsFromString unknown field " << token;
+        }
+        return fields;
     }
 
+    static uint32_t jointsFromString(const string& s) {
+        uint32_t joints = 0;
+        for(auto&& token : splitNames(s)) {
+            if(token == "all") return kAllJoints;
+            int j = jointIndex(token);
+            if(j >= 0) joints |= 1u << j;
+            else ofLogError() << "OscSender::jointsFromString unknown joint " << token;
+        }
+        return joints;
+    }
+
+    static string fieldsToString(int fields) {
+        if(fields == kAllFields) return "all";
+        string s;
+        for(int f=0; f<kNumFields; f++) if(fields & (1 << f)) s += (s.empty() ? "" : " ") + string(kFieldNames[f]);
+        return s;
+    }
+
+    static string jointsToString(uint32_t joints) {
+        if(joints == kAllJoints) return "all";
+        string s;
+        for(int j=0; j<kNumJoints; j++) if(joints & (1u << j)) s += (s.empty() ? "" : " ") + string(kJointNames[j]);
+        return s;
+    }
 
 
+private:
+    DatagramSocket socket;
+    OscEncoder encoder;
 
+    float send_timer = 0;
+    float refresh_timer = 0;
+    int last_num_persons = -1;
+    bool logged_too_big = false;    // a person didn't fit, only logged the first time
+    ofVec3f last_sent[OscEncoder::kMaxPersons][kNumJoints];    // pos of each joint when it was last sent
+    ofQuaternion last_sent_quat[OscEncoder::kMaxPersons][kNumJoints];
+
+    uint64_t num_datagrams = 0;
+    uint64_t num_bytes = 0;
+    uint64_t send_nanos = 0;    // spent in flush() this sendPersons()
+
+    // joints of the person at output index i that moved (or turned) more than deadband since they were last sent.
+    // only what this output sends counts: everything but quat and euler follows the positions, those two the rotations
+    uint32_t changedJoints(int i, const Person& person) const {
+        int fields = encoder.getFields();
+        bool positions = fields & ~(kFieldQuat | kFieldEuler);
+        bool rotations = fields & (kFieldQuat | kFieldEuler);
+
+        // two rotations are more than deadband radians apart when |dot| of their quats is below cos(deadband / 2)
+        float deadband2 = deadband * deadband;
+        float min_dot = cosf(min(deadband, float(PI)) * 0.5f);
+
+        uint32_t changed = 0;
+        for(int j=0; j<kNumJoints; j++) {
+            if(positions && person.joints.pos[j].squareDistance(last_sent[i][j]) > deadband2) changed |= 1u << j;
+            if(rotations) {
+                const ofVec4f& q = person.joints.quat[j]._v;
+                const ofVec4f& s = last_sent_quat[i][j]._v;
+                if(fabsf(q.x * s.x + q.y * s.y + q.z * s.z + q.w * s.w) < min_dot) changed |= 1u << j;
+            }
+        }
+        return changed;
+    }
+
+    void flush() {
+        if(encoder.isEmpty()) return;
+        uint64_t start = Telemetry::nanos();
+        if(socket.send(encoder.getData(), encoder.getSize())) {
+            num_datagrams++;
+            num_bytes += encoder.getSize();
+            Telemetry& telemetry = Telemetry::get();
+            telemetry.count(kCounterDatagramsOut);
+            telemetry.count(kCounterBytesOut, encoder.getSize());
+        }
+        uint64_t nanos = Telemetry::nanos() - start;
+        Telemetry::get().addTime(kStageSend, nanos);
+        send_nanos += nanos;
+    }
+
+    static vector<string> splitNames(string s) {
+        std::replace(s.begin(), s.end(), ',', ' ');
+        return ofSplitString(s, " ", true, true);
+    }
 };
 
 }
@@ -0,0 +1,246 @@
+
+#include "PacketLog.h"
+
+#ifdef TARGET_WIN32
+#define fseeko  _fseeki64
+#define ftello  _ftelli64
+#endif
+
+namespace pr {
+
+using namespace packetlog;
+
+// how often the recorder thread writes out what has come in
+#define kFlushMillis    100
+
+
+PacketRecorder::~PacketRecorder() {
+    stop();
+}
+
+
+bool PacketRecorder::start(const string& p) {
+    stop();
+
+    path = ofToDataPath(p, true);
+    ofDirectory::createDirectory(ofFilePath::getEnclosingDirectory(path, false), false, true);
+    FILE* f = fopen(path.c_str(), "wb");
+    if(!f) {
+        ofLogError() << "PacketRecorder::start couldn't create " << path;
+        return false;
+    }
+
+    FileHeader header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.reserved = 0;
+    header.start_unix_micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    fwrite(&header, sizeof(header), 1, f);
+
+    index.clear();
+    end_offset = sizeof(header);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        pending.clear();
+        num_records = 0;
+        num_bytes = 0;
+        start_micros = ofGetElapsedTimeMicros();
+        file = f;
+    }
+
+    startThread();
+    ofLogNotice() << "PacketRecorder::start recording to " << path;
+    return true;
+}
+
+
+void PacketRecorder::stop() {
+    if(!file) return;
+
+    stopThread();
+    waitForThread(false);
+
+    // nothing more is added once file is NULL, so the index matches what's written
+    std::unique_lock<std::mutex> lock(mutex);
+    FILE* f = file;
+    file = NULL;
+    writing.swap(pending);
+    lock.unlock();
+    write(f);
+
+    // the index, so a replay can seek without reading the whole log
+    Footer footer;
+    footer.count = index.size();
+    footer.index_offset = end_offset;
+    memcpy(footer.magic, kIndexMagic, sizeof(kIndexMagic));
+    if(!index.empty()) fwrite(index.data(), sizeof(IndexEntry), index.size(), f);
+    fwrite(&footer, sizeof(footer), 1, f);
+    fclose(f);
+
+    ofLogNotice() << "PacketRecorder::stop recorded " << num_records << " datagrams (" << num_bytes / 1024 << "KB) to " << path;
+}
+
+
+void PacketRecorder::add(int port, const Packet& packet, bool dropped) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if(!file) return;
+
+    RecordHeader header;
+    header.micros = packet.arrival_micros > start_micros ? packet.arrival_micros - start_micros : 0;
+    header.port = port;
+    header.flags = dropped ? kFlagDropped : 0;
+    header.size = packet.size;
+
+    // grows to what a flush interval needs and then stays that size
+    const char* h = reinterpret_cast<const char*>(&header);
+    pending.insert(pending.end(), h, h + sizeof(header));
+    pending.insert(pending.end(), packet.data, packet.data + packet.size);
+
+    num_records++;
+    num_bytes += packet.size;
+}
+
+
+void PacketRecorder::threadedFunction() {
+    while(isThreadRunning()) {
+        ofSleepMillis(kFlushMillis);
+        std::unique_lock<std::mutex> lock(mutex);
+        writing.swap(pending);
+        FILE* f = file;
+        lock.unlock();
+        write(f);
+    }
+}
+
+
+void PacketRecorder::write(FILE* f) {
+    if(!writing.empty()) {
+        if(fwrite(writing.data(), 1, writing.size(), f) != writing.size()) ofLogError() << "PacketRecorder::write couldn't write to " << path;
+        fflush(f);
+    }
+
+    // whole records, as add() put them in
+    for(size_t i=0; i + sizeof(RecordHeader) <= writing.size(); ) {
+        RecordHeader header;
+        memcpy(&header, &writing[i], sizeof(header));
+        IndexEntry entry;
+        entry.micros = header.micros;
+        entry.offset = end_offset + i;
+        index.push_back(entry);
+        i += sizeof(header) + header.size;
+    }
+    end_offset += writing.size();
+    writing.clear();
+}
+
+
+
+bool PacketReplay::open(const string& p) {
+    close();
+
+    path = ofToDataPath(p, true);
+    file = fopen(path.c_str(), "rb");
+    if(!file) {
+        ofLogError() << "PacketReplay::open couldn't open " << path;
+        return false;
+    }
+
+    FileHeader header;
+    if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, kMagic, sizeof(kMagic)) || header.version != kVersion) {
+        ofLogError() << "PacketReplay::open " << path << " isn't a packet log";
+        close();
+        return false;
+    }
+    start_unix_micros = header.start_unix_micros;
+
+    if(!loadIndex()) {
+        ofLogWarning() << "PacketReplay::open " << path << " has no (valid) index (recording didn't stop cleanly?), scanning it";
+        if(!scanIndex()) {
+            close();
+            return false;
+        }
+    }
+
+    buffer.resize(Packet::kMaxSize);
+    next = 0;
+    ofLogNotice() << "PacketReplay::open " << path << ": " << index.size() << " datagrams, " << ofToString(getDuration() / 1e6f, 1) << "s";
+    return true;
+}
+
+
+void PacketReplay::close() {
+    if(file) fclose(file);
+    file = NULL;
+    index.clear();
+    next = 0;
+}
+
+
+void PacketReplay::swap(PacketReplay& other) {
+    std::swap(file, other.file);
+    path.swap(other.path);
+    std::swap(start_unix_micros, other.start_unix_micros);
+    index.swap(other.index);
+    std::swap(next, other.next);
+    buffer.swap(other.buffer);
+}
+
+
+void PacketReplay::seek(uint64_t micros) {
+    IndexEntry key;
+    key.micros = micros;
+    next = std::lower_bound(index.begin(), index.end(), key, [](const IndexEntry& a, const IndexEntry& b) { return a.micros < b.micros; }) - index.begin();
+}
+
+
+bool PacketReplay::read(int i, RecordHeader& header) {
+    if(fseeko(file, index[i].offset, SEEK_SET) != 0 || fread(&header, sizeof(header), 1, file) != 1 || header.size > buffer.size()) {
+        ofLogError() << "PacketReplay::read bad record " << i << " in " << path;
+        return false;
+    }
+    return fread(buffer.data(), 1, header.size, file) == header.size;
+}
+
+
+bool PacketReplay::loadIndex() {
+    Footer footer;
+    if(fseeko(file, -(int64_t)sizeof(footer), SEEK_END) != 0 || fread(&footer, sizeof(footer), 1, file) != 1) return false;
+    if(memcmp(footer.magic, kIndexMagic, sizeof(kIndexMagic))) return false;
+
+    // only if the index fills the file exactly up to the footer, a truncated or corrupt log is scanned instead
+    uint64_t size = ftello(file);
+    if(size < sizeof(FileHeader) + sizeof(footer)) return false;
+    uint64_t end = size - sizeof(footer);
+    if(footer.index_offset < sizeof(FileHeader) || footer.index_offset > end) return false;
+    uint64_t index_size = end - footer.index_offset;
+    if(index_size % sizeof(IndexEntry) || footer.count != index_size / sizeof(IndexEntry)) return false;
+
+    index.resize(footer.count);
+    if(fseeko(file, footer.index_offset, SEEK_SET) != 0) return false;
+    return footer.count == 0 || fread(index.data(), sizeof(IndexEntry), footer.count, file) == footer.count;
+}
+
+
+bool PacketReplay::scanIndex() {
+    index.clear();
+    uint64_t offset = sizeof(FileHeader);
+    fseeko(file, offset, SEEK_SET);
+
+    // up to the last whole record, the end of an unfinished log may be cut off
+    RecordHeader header;
+    while(fread(&header, sizeof(header), 1, file) == 1 && header.size <= Packet::kMaxSize) {
+        if(fseeko(file, header.size, SEEK_CUR) != 0) break;
+        IndexEntry entry;
+        entry.micros = header.micros;
+        entry.offset = offset;
+        index.push_back(entry);
+        offset += sizeof(header) + header.size;
+    }
+
+    // the last one may be cut short, fseek past the end doesn't fail
+    fseeko(file, 0, SEEK_END);
+    if(!index.empty() && (uint64_t)ftello(file) < offset) index.pop_back();
+    return true;
+}
+
+}
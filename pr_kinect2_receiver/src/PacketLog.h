@@ -0,0 +1,143 @@
+/*
+ Records every datagram that arrives on any receiver port to one file, and plays it back in place of the sockets
+ - PacketRecorder is fed by the NetworkThread as datagrams come in and writes them out on its own thread
+ - PacketReplay reads them back in order, the Pipeline feeds them to the receivers' queues as its (replay) clock passes them,
+   stamped with their recorded arrival times, so a replay goes through exactly what the live run did, at any speed
+
+ file layout (little endian):
+ - header: "PRPACKET", uint32 version, uint32 reserved, uint64 start time (unix micros)
+ - records: uint64 micros since start, uint16 port, uint16 flags, uint32 size, the datagram
+ - index, written on stop: per record its micros and file offset (uint64 each), then uint64 count, uint64 index offset, "PRINDEX1".
+   a log without one (e.g. the recorder crashed) is scanned instead
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "NetworkThread.h"
+
+namespace pr {
+
+namespace packetlog {
+
+static const char kMagic[8] = { 'P', 'R', 'P', 'A', 'C', 'K', 'E', 'T' };
+static const char kIndexMagic[8] = { 'P', 'R', 'I', 'N', 'D', 'E', 'X', '1' };
+static const uint32_t kVersion = 1;
+
+enum Flags {
+    kFlagDropped = 1 << 0   // the receiver's queue was full, it never saw this one
+};
+
+#pragma pack(push, 1)
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t start_unix_micros;
+};
+
+struct RecordHeader {
+    uint64_t micros;
+    uint16_t port;
+    uint16_t flags;
+    uint32_t size;
+};
+
+struct IndexEntry {
+    uint64_t micros;
+    uint64_t offset;
+};
+
+struct Footer {
+    uint64_t count;
+    uint64_t index_offset;
+    char magic[8];
+};
+#pragma pack(pop)
+
+}
+
+
+class PacketRecorder : public ofThread {
+public:
+    ~PacketRecorder();
+
+    // returns false if the file couldn't be created
+    bool start(const string& path);
+
+    // writes out what's left and the index
+    void stop();
+
+    bool isRecording() const    { return isThreadRunning(); }
+    const string& getPath() const   { return path; }
+    uint64_t numRecords() const { return num_records; }
+    uint64_t numBytes() const   { return num_bytes; }
+
+    // network thread. copies the datagram, the file is written on the recorder's thread
+    void add(int port, const Packet& packet, bool dropped);
+
+protected:
+    FILE* file = NULL;
+    string path;
+    uint64_t start_micros = 0;      // ofGetElapsedTimeMicros() at start
+
+    // guarded by mutex
+    vector<char> pending;           // records not written yet
+    atomic<uint64_t> num_records { 0 };
+    atomic<uint64_t> num_bytes { 0 };
+
+    // recorder thread only (and stop(), once it's gone)
+    vector<char> writing;
+    vector<packetlog::IndexEntry> index;    // of the records written, grows here rather than on the network thread
+    uint64_t end_offset = 0;        // where the next record goes in the file
+
+    void threadedFunction() override;
+    void write(FILE* f);    // writes out writing, and indexes it
+};
+
+
+class PacketReplay {
+public:
+    ~PacketReplay()             { close(); }
+
+    // returns false if it isn't a packet log
+    bool open(const string& path);
+    void close();
+
+    // trade everything with other, so a replay can be opened or closed elsewhere and only swapped in or out
+    void swap(PacketReplay& other);
+
+    bool isOpen() const         { return file != NULL; }
+    bool isFinished() const     { return next >= index.size(); }
+    const string& getPath() const   { return path; }
+    uint64_t getDuration() const    { return index.empty() ? 0 : index.back().micros; }
+    uint64_t getStartUnixMicros() const { return start_unix_micros; }
+    int numRecords() const      { return index.size(); }
+    int numPlayed() const       { return next; }
+
+    // back to the first record at or after micros
+    void seek(uint64_t micros);
+
+    // fn(port, data, size, micros, flags) for every record up to and including micros (since the start of the log), in order
+    template<typename Fn> void playUntil(uint64_t micros, Fn fn) {
+        while(next < index.size() && index[next].micros <= micros) {
+            packetlog::RecordHeader header;
+            if(!read(next++, header)) continue;
+            fn(header.port, buffer.data(), header.size, header.micros, header.flags);
+        }
+    }
+
+protected:
+    FILE* file = NULL;
+    string path;
+    uint64_t start_unix_micros = 0;
+    vector<packetlog::IndexEntry> index;
+    int next = 0;                   // next record to play
+    vector<char> buffer;            // the record last read
+
+    bool read(int i, packetlog::RecordHeader& header);
+    bool loadIndex();
+    bool scanIndex();
+};
+
+}
@@ -6,34 +6,38 @@
 #pragma once
 
 #include "ofMain.h"
+#include "Joints.h"
 
 namespace pr {
 
-// helper class for smoothing parameters
-template<typename T> struct Smoother {
-    T current, target;
-    void update(float smoothing) { current += (target - current) * (1 - smoothing); }
-
+// joint information, struct of arrays indexed by JointIndex (see Joints.h)
+struct Joints {
+    float confidence[kNumJoints];           // 0..1 confidence rating
+    ofVec3f pos[kNumJoints];                // world position, with smoothing
+    ofVec3f pos_target[kNumJoints];         // world position, as received
+    ofQuaternion quat[kNumJoints];          // world orientation as quat
+    ofVec3f euler[kNumJoints];              // world orienation as euler
+    ofVec3f vel[kNumJoints];                // velocity vector, with smoothing
+    ofVec3f vel_target[kNumJoints];         // velocity vector, as received
+    float speed[kNumJoints];                // speed, with smoothing
+    ofVec3f vec[kNumJoints];                // vector to parent
+    ofVec3f springy_pos[kNumJoints];        // positions with springy behaviour applied
+    ofVec3f springy_vel[kNumJoints];        // velocities with springy behaviour applied
+    float range[kNumJoints];                // distance from the sensor, as received
 };
 
 
-struct JointInfo {
-    float confidence;       // 0..1 confidence rating
-    Smoother<ofVec3f> pos;  // world position, with smoothing
-    ofQuaternion quat;      // world orientation as quat
-    ofVec3f euler;          // world orienation as euler
-    Smoother<ofVec3f> vel;  // velocity vector, with smoothing
-    float speed;            // speed, with smoothing
-    ofVec3f vec;            // vector to parent
-	string parentJointName; // name of the parent joint for vec
-    ofVec3f springy_pos;    // positions with springy behaviour applied
-    ofVec3f springy_vel;    // velocities with springy behaviour applied
-};
+struct Person {
 
+	// persons are owned by a PersonPool, everyone else just points at them
+	typedef Person* Ptr;
 
-struct Person {
+    // id of this person on the tracker it came from
+    int user_id = -1;
 
-	typedef shared_ptr<Person> Ptr;
+    // index of the receiver it came from (1, 2, 3 etc.), and id of the physical person across all receivers (see Association.h)
+    int sensor = 0;
+    int global_id = -1;
 
     // keep alive for XXX frames
     int alive_counter = 0;
@@ -42,84 +46,99 @@ struct Person {
     ofColor color = ofColor::yellow;
 
     // joint information
-    map<string, JointInfo> joints;
-
-	// xml for loadin joint map info
-	ofXml jointXml;
-
-	Person() {
-		// total number of tracked joints
-		int numJoints = 25;
-
-		jointXml.load("joints.xml");
-		jointXml.setTo("//JointInfo");
-
-		for (int i = 0; i < numJoints; i++) {
-			string tempJointName = jointXml.getValue<string>("JointNames/joint[" + ofToString(i) + "]");
-			joints[tempJointName] = JointInfo();
-			joints[tempJointName].parentJointName = jointXml.getValue<string>("JointParents/parent[" + ofToString(i) + "]");
-		}
-	};
+    Joints joints = Joints();
+
+    // clear all state, for reusing a pooled person
+    void reset(int id) {
+        user_id = id;
+        global_id = -1;
+        alive_counter = 0;
+        joints = Joints();
+    }
 
     // other info? hand states, lean, restrictedness etc
 
 
-    /*
-    // diffs to another person. useful for detecting if two people from different kinects are the same person or not
-    // ignore for now
-
-    // L1 norm of diffs to another person
-    float dist(Ptr other) {
-        float s = 0;
-        for(auto&& j : joints) s += (j.second.pos.current - other->joints[j.first].pos.current).length();
-        return s;
-    }
-
-
-    // L2 norm of diffs to another person
-    float dist2(Ptr other) {
+    // mean distance between the joints both persons are confident about (waist distance if there are none)
+    // useful for detecting if two people from different kinects are the same person or not
+    float distance(const Person& other, float min_confidence = 0.5) const {
         float s = 0;
-        for(auto&& j : joints) s += (j.second.pos.current - other->joints[j.first].pos.current).lengthSquared();
-        return sqrt(s);
+        int n = 0;
+        for(int j=0; j<kNumJoints; j++) {
+            if(joints.confidence[j] < min_confidence || other.joints.confidence[j] < min_confidence) continue;
+            s += joints.pos[j].distance(other.joints.pos[j]);
+            n++;
+        }
+        return n ? s / n : joints.pos[kJointWaist].distance(other.joints.pos[kJointWaist]);
     }
-*/
 
     // used for sorting persons left to right using waist position
-    static bool compare(Ptr a, Ptr b) { return a->joints["waist"].pos.current.x < b->joints["waist"].pos.current.x; }
+    static bool compare(const Person* a, const Person* b) { return a->joints.pos[kJointWaist].x < b->joints.pos[kJointWaist].x; }
 
 
+#ifndef PR_HEADLESS
     // draw person
-    void draw(float joint_radius, bool show_target_pos, bool show_springy_pos, bool show_vel, float vel_mult) {
+    void draw(float joint_radius, bool show_target_pos, bool show_springy_pos, bool show_vel, float vel_mult) const {
 
        // iterate joints
-       for(auto&& jkv : joints) {
-           JointInfo& joint = jkv.second;
+       for(int j=0; j<kNumJoints; j++) {
+           const ofVec3f& pos = joints.pos[j];
 
            ofSetColor(color);
 
            // draw limb
-           ofDrawLine(joint.pos.current, joint.pos.current + joint.vec);
+           ofDrawLine(pos, pos + joints.vec[j]);
 
            // draw target (non smoothed joint)
-           if(show_target_pos) ofDrawSphere(joint.pos.target, joint_radius);
+           if(show_target_pos) ofDrawSphere(joints.pos_target[j], joint_radius);
 
            // draw springy_pos
-           if(show_springy_pos) ofDrawSphere(joint.springy_pos, joint_radius);
+           if(show_springy_pos) ofDrawSphere(joints.springy_pos[j], joint_radius);
 
            //  draw joint (Faded if showing target or springypos)
            ofSetColor(color, show_target_pos || show_springy_pos ? 50 : 255);
-           ofDrawSphere(joint.pos.current, joint_radius);
+           ofDrawSphere(pos, joint_radius);
 
 
            // draw velocity vector
            if(show_vel) {
                ofSetColor(255);
-               ofDrawArrow(joint.pos.current, joint.pos.current + joint.vel.current * vel_mult, 0.02f);
+               ofDrawArrow(pos, pos + joints.vel[j] * vel_mult, 0.02f);
            }
        }
     }
+#endif
 };
 
 
+
+// fixed number of persons allocated up front and recycled, so new users don't allocate
+class PersonPool {
+public:
+    PersonPool(int capacity) : storage(capacity) {
+        free_persons.reserve(capacity);
+        for(int i=capacity-1; i>=0; i--) free_persons.push_back(&storage[i]);
+    }
+
+    // returns NULL if all persons are in use
+    Person* acquire(int user_id) {
+        if(free_persons.empty()) return NULL;
+        Person* person = free_persons.back();
+        free_persons.pop_back();
+        person->reset(user_id);
+        return person;
+    }
+
+    void release(Person* person) {
+        if(person) free_persons.push_back(person);
+    }
+
+    int capacity() const { return storage.size(); }
+
+private:
+    vector<Person> storage;         // never resized, so pointers stay valid
+    vector<Person*> free_persons;
+};
+
 }
 
@@ -0,0 +1,624 @@
+
+#include "Pipeline.h"
+
+#ifndef PR_HEADLESS
+#include "ofxImGui.h"
+#endif
+
+namespace pr {
+
+static_assert(Reducer::kMaxSlots <= OscEncoder::kMaxPersons, "every output slot needs its /skel/<i> addresses");
+
+// receivers to start with if settings has none
+#define kDefaultReceivers   3
+
+// replays "as fast as possible" tick at most this often (per second)
+#define kMaxFastTicks       2000
+
+// (micros) the pipeline is left unlocked for at least this long between ticks that run late or flat out
+#define kMinTickGap         50
+
+float Pipeline::rate = 30;
+
+
+Pipeline::~Pipeline() {
+    stop();
+}
+
+
+void Pipeline::setup() {
+    // parse joints.xml now, so the first person to show up doesn't cause any disk access
+    JointSchema::get();
+
+    network.start();
+
+    persons_global_reduced.reserve(Reducer::kMaxSlots);
+    persons_global_unique.reserve(Associator::kMaxTracks);
+    for(int i=0; i<3; i++) {
+        snapshots[i].persons_all.reserve(Associator::kMaxTracks);
+        snapshots[i].persons_reduced.reserve(Reducer::kMaxSlots);
+    }
+}
+
+
+void Pipeline::start() {
+    if(!isThreadRunning()) startThread();
+}
+
+
+void Pipeline::stop() {
+    if(isThreadRunning()) {
+        stopThread();
+        waitForThread(false);
+    }
+    stopRecording();
+    network.stop();
+}
+
+
+void Pipeline::threadedFunction() {
+    uint64_t next = ofGetElapsedTimeMicros();
+    while(isThreadRunning()) {
+        // fixed steps. sleep until the next is due, or start right away if we're late
+        uint64_t period = 1000000 / max(rate, 1.0f);
+        uint64_t wait = tickWait(period);
+        next += wait;
+        uint64_t now = ofGetElapsedTimeMicros();
+        if(next > now) {
+            std::this_thread::sleep_for(std::chrono::microseconds(next - now));
+        } else {
+            // way behind (e.g. stopped in the debugger), don't try to catch up
+            if(now - next > 4 * wait) next = now;
+
+            // a sped up replay running flat out would take the lock straight back every time,
+            // leave it for a moment so drawGui() and the other callers get a turn
+            if(wait < period) std::this_thread::sleep_for(std::chrono::microseconds(kMinTickGap));
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        // settings reloaded in the meantime
+        shared_ptr<ofXml> xml;
+        {
+            std::unique_lock<std::mutex> queued_lock(queued_mutex);
+            xml.swap(queued_xml);
+        }
+        if(xml) applyXml(*xml);
+
+        if(replay.isOpen() && replay_paused) {
+            if(replay_steps == 0) {
+                // nothing moves, but the GUI still wants to see its changes
+                publish();
+                continue;
+            }
+            replay_steps--;
+        }
+        uint64_t start = Telemetry::nanos();
+        tick(period / 1000000.0f);
+        uint64_t tick_nanos = Telemetry::nanos() - start;
+        Telemetry::get().addTime(kStageTick, tick_nanos);
+        tick_millis = tick_nanos / 1000000.0f;
+        publish();
+    }
+}
+
+
+uint64_t Pipeline::tickWait(uint64_t period) {
+    // a replay ticks more or less often, but each tick is still one period on its clock
+    std::unique_lock<std::mutex> lock(mutex);
+    if(!replay.isOpen() || replay_paused) return period;
+    if(replay_fast) return 1000000 / kMaxFastTicks;
+    return period / max(replay_speed, 0.01f);
+}
+
+
+void Pipeline::setNumReceivers(int count) {
+    while(receivers.size() < count) receivers.push_back(shared_ptr<Receiver>(new Receiver(receivers.size() + 1, network)));
+    while(receivers.size() > count) receivers.pop_back();
+
+    // spread colors evenly around the hue circle (3 receivers are red, green, blue)
+    for(int i=0; i<receivers.size(); i++) receivers[i]->setColor(ofColor::fromHsb(255.0f * i / receivers.size(), 255, 255));
+
+    persons_global_all.reserve(receivers.size() * Receiver::kMaxPersons);
+    for(int i=0; i<3; i++) snapshots[i].persons_all.reserve(Associator::kMaxTracks + receivers.size() * Receiver::kMaxPersons);
+}
+
+
+void Pipeline::setNumOutputs(int count) {
+    while(osc_senders.size() < count) osc_senders.push_back(shared_ptr<OscSender>(new OscSender()));
+    while(osc_senders.size() > count) osc_senders.pop_back();
+}
+
+
+void Pipeline::tick(float dt) {
+
+    // clear all persons list
+    persons_global_all.clear();
+
+    // live, or the datagrams of the replay up to this tick
+    if(replay.isOpen()) playReplay(dt);
+    else now_micros = ofGetElapsedTimeMicros();
+
+    // sample all receivers at the same moment, far enough in the past that the slowest has frames on both sides of it
+    int64_t delay = 0;
+    for(auto&& receiver : receivers) if(receiver) delay = max(delay, receiver->getDelay());
+    int64_t target_micros = now_micros - delay;
+
+    // first pass, parse all waiting osc and process receivers, all in parallel
+    pool.parallelFor(receivers.size(), [&](int i) {
+        if(receivers[i]) receivers[i]->update(target_micros, dt);
+    });
+
+    // then add to global list of persons, in receiver order
+    for(auto&& receiver : receivers) {
+        if(receiver) receiver->appendPersons(persons_global_all);
+        else ofLogError() << "Pipeline::tick receiver == NULL";
+    }
+
+    // second pass, work out who's who across receivers and fuse them (needs persons_global_all still grouped by receiver)
+    {
+        ScopedTimer timer(kStageFusion);
+        associator.update(persons_global_all, dt);
+        associator.getPersons(persons_global_unique);
+    }
+
+    {
+        ScopedTimer timer(kStageReduction);
+        reduce();
+    }
+
+    // ahead by the latency, what goes out (and is drawn) from here on is the predicted copies
+    {
+        ScopedTimer timer(kStagePrediction);
+        predictor.predict(persons_global_reduced, reducer.getSlotKeys(), delay, dt);
+    }
+
+    // send osc
+    sendOsc(dt);
+
+    // and all fused persons to anyone reading shared memory
+    {
+        ScopedTimer timer(kStageSend);
+        shared_sender.send(persons_global_unique);
+    }
+
+    Telemetry& telemetry = Telemetry::get();
+    telemetry.set(kGaugePersons, persons_global_all.size());
+    telemetry.set(kGaugeUniquePersons, persons_global_unique.size());
+
+    // every interval, the summary to the outputs that want it
+    float stats[Telemetry::kNumStatsValues];
+    if(telemetry.update(dt, stats)) {
+        for(auto&& osc_sender : osc_senders) osc_sender->sendStats(stats, Telemetry::kNumStatsValues);
+    }
+}
+
+
+void Pipeline::playReplay(float dt) {
+    now_micros += dt * 1000000;
+    replay.playUntil(now_micros - replay_start, [&](int port, const char* data, int size, uint64_t micros, int flags) {
+        // the receiver didn't get it live either
+        if(flags & packetlog::kFlagDropped) return;
+        network.inject(port, data, size, replay_start + micros);
+    });
+
+    if(replay.isFinished()) {
+        if(replay_loop) {
+            replay.seek(0);
+            replay_start = now_micros;
+        } else {
+            ofLogNotice() << "Pipeline::playReplay finished " << replay.getPath();
+            PacketReplay closed;
+            endReplay(closed);
+        }
+    }
+}
+
+
+bool Pipeline::startRecording(const string& path) {
+    string p = path.empty() ? "recordings/" + ofGetTimestampString("%Y-%m-%d-%H-%M-%S") + ".prlog" : path;
+    if(!recorder.start(p)) return false;
+    network.setRecorder(&recorder);
+    return true;
+}
+
+
+void Pipeline::stopRecording() {
+    if(!recorder.isRecording()) return;
+    network.setRecorder(NULL);
+    recorder.stop();
+    strncpy(replay_path, recorder.getPath().c_str(), sizeof(replay_path) - 1);
+}
+
+
+bool Pipeline::startReplay(const string& path) {
+    // opened (and scanned, if it has no index) before locking. the replay it replaces is closed after unlocking
+    PacketReplay opened;
+    if(!opened.open(path)) return false;
+    std::unique_lock<std::mutex> lock(mutex);
+    beginReplay(opened);
+    return true;
+}
+
+
+void Pipeline::stopReplay() {
+    // closed after unlocking
+    PacketReplay closed;
+    std::unique_lock<std::mutex> lock(mutex);
+    endReplay(closed);
+}
+
+
+void Pipeline::stepReplay() {
+    std::unique_lock<std::mutex> lock(mutex);
+    replay_steps++;
+}
+
+
+bool Pipeline::isReplaying() {
+    std::unique_lock<std::mutex> lock(mutex);
+    return replay.isOpen();
+}
+
+
+void Pipeline::beginReplay(PacketReplay& opened) {
+    // opened gets the one replaced, if any
+    replay.swap(opened);
+
+    // nothing from before, or from the sockets from now on
+    network.setLive(false);
+    for(auto&& receiver : receivers) receiver->resetStream();
+    replay_start = now_micros = ofGetElapsedTimeMicros();
+    replay_steps = 0;
+}
+
+
+void Pipeline::endReplay(PacketReplay& closed) {
+    if(!replay.isOpen()) return;
+    replay.swap(closed);
+
+    // the replay clock may have run ahead of the real one, start over
+    for(auto&& receiver : receivers) receiver->resetStream();
+    network.setLive(true);
+    now_micros = ofGetElapsedTimeMicros();
+}
+
+
+void Pipeline::reduce() {
+    // left to right, for the shared memory output
+    std::sort(persons_global_unique.begin(), persons_global_unique.end(), Person::compare);
+
+    // into the configured output slots
+    reducer.reduce(persons_global_unique, persons_global_reduced);
+}
+
+
+void Pipeline::sendOsc(float dt) {
+    // every output gets the same persons, and picks what it wants from them. encoded straight into its buffer, nothing allocated
+    for(auto&& osc_sender : osc_senders) osc_sender->sendPersons(persons_global_reduced, dt);
+}
+
+
+void Pipeline::publish() {
+    Snapshot& snapshot = snapshots.back();
+
+    // persons are plain arrays, so copying them into reserved vectors doesn't allocate
+    snapshot.persons_all.clear();
+    for(auto person : persons_global_all) snapshot.persons_all.push_back(*person);
+
+    snapshot.persons_reduced.clear();
+    for(auto person : persons_global_reduced) if(person) snapshot.persons_reduced.push_back(*person);
+
+    snapshot.sensors.resize(receivers.size());
+    for(int i=0; i<receivers.size(); i++) {
+        Snapshot::Sensor& sensor = snapshot.sensors[i];
+        sensor.enabled = receivers[i]->isEnabled();
+        sensor.matrix = receivers[i]->getNode().getGlobalTransformMatrix();
+        sensor.floor_quat = receivers[i]->floorQuat;
+    }
+
+    snapshot.num_unique = persons_global_unique.size();
+    snapshot.num_tracks = associator.numTracks();
+    snapshot.associator_millis = associator.getMillis();
+    snapshot.tick_millis = tick_millis;
+
+#ifndef PR_HEADLESS
+    // only as often as the GUI is drawn
+    snapshot.has_gui = gui_wanted.exchange(false);
+    if(snapshot.has_gui) getGuiState(snapshot.gui);
+#endif
+
+    snapshots.publish();
+}
+
+
+void Pipeline::loadFromXml(ofXml& xml) {
+    std::unique_lock<std::mutex> lock(mutex);
+    applyXml(xml);
+}
+
+
+void Pipeline::queueXml(shared_ptr<ofXml> xml) {
+    std::unique_lock<std::mutex> lock(queued_mutex);
+    queued_xml = xml;
+}
+
+
+void Pipeline::applyXml(ofXml& xml) {
+    // as many receivers as there are in the settings
+    int count = 0;
+    if(xml.exists("//Settings/Receivers")) {
+        xml.setTo("//Settings/Receivers");
+        count = xml.getNumChildren("receiver");
+    }
+    setNumReceivers(count > 0 ? count : kDefaultReceivers);
+
+    // tell receivers to fetch their settings from loaded xml
+    for(auto&& receiver : receivers) {
+        if(receiver) receiver->loadFromXml(xml);
+        else ofLogError() << "Pipeline::loadFromXml receiver == NULL";
+    }
+
+    // one sender per <output>, or just the one from <Sender> in older settings
+    if(xml.exists("//Settings/Outputs")) {
+        xml.setTo("//Settings/Outputs");
+        setNumOutputs(xml.getNumChildren("output"));
+        for(int i=0; i<osc_senders.size(); i++) {
+            xml.setTo("//Settings/Outputs/output[" + ofToString(i) + "]");
+            osc_senders[i]->loadFromXml(xml);
+        }
+    } else if(xml.exists("//Settings/Sender")) {
+        setNumOutputs(1);
+        xml.setTo("//Settings/Sender");
+        osc_senders[0]->loadFromXml(xml);
+    } else {
+        setNumOutputs(1);
+        osc_senders[0]->setup("127.0.0.1", 8000);
+    }
+    shared_sender.loadFromXml(xml);
+    reducer.loadFromXml(xml);
+    predictor.loadFromXml(xml);
+    associator.loadFromXml(xml);
+    Telemetry::get().loadFromXml(xml);
+
+    if(xml.exists("//Settings/Processing")) {
+        xml.setTo("//Settings/Processing");
+        if(xml.exists("rate")) rate = xml.getFloatValue("rate");
+    }
+}
+
+
+void Pipeline::saveToXml(ofXml& xml) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+	xml.setTo("//Settings");
+	xml.addChild("Receivers");
+	xml.setTo("Receivers");
+
+	xml.addValue("pos_smoothing", ofToString(Receiver::pos_smoothing));
+	xml.addValue("vel_smoothing", ofToString(Receiver::vel_smoothing));
+	xml.addValue("spring_strength", ofToString(Receiver::spring_strength));
+	xml.addValue("spring_damping", ofToString(Receiver::spring_damping));
+	xml.addValue("kill_frame_count", ofToString(Receiver::kill_frame_count));
+	xml.addValue("jitter_buffer", ofToString(Receiver::jitter_buffer));
+	xml.addValue("jitter_mult", ofToString(Receiver::jitter_mult));
+	xml.addValue("jitter_min_delay", ofToString(Receiver::jitter_min_delay));
+	xml.addValue("jitter_max_delay", ofToString(Receiver::jitter_max_delay));
+
+	// tell receivers to write the settings to xml to be saved
+	for (auto&& receiver : receivers) {
+		if (receiver) receiver->saveToXml(xml);
+		else ofLogError() << "Pipeline::saveToXml receiver == NULL";
+	}
+
+	xml.setTo("//Settings");
+	xml.addChild("Outputs");
+	for (int i=0; i<osc_senders.size(); i++) {
+		xml.setTo("//Settings/Outputs");
+		xml.addChild("output");
+		xml.setTo("output[" + ofToString(i) + "]");
+		osc_senders[i]->saveToXml(xml);
+	}
+	shared_sender.saveToXml(xml);
+	reducer.saveToXml(xml);
+	predictor.saveToXml(xml);
+	associator.saveToXml(xml);
+	Telemetry::get().saveToXml(xml);
+
+	xml.setTo("//Settings");
+	xml.addChild("Processing");
+	xml.setTo("Processing");
+	xml.addValue("rate", ofToString(rate));
+}
+
+
+#ifndef PR_HEADLESS
+void Pipeline::drawGui(const Snapshot& snapshot) {
+    // the state the pipeline published, unless it's from before our last change went in (then ours is newer)
+    gui_wanted = true;
+    if(snapshot.has_gui && snapshot.gui.num_sets == gui_sets) {
+        gui_state = snapshot.gui;
+        has_gui_state = true;
+    }
+    if(!has_gui_state) return;
+    GuiState& gui = gui_state;
+
+    bool changed = false;
+    ImGui::CollapsingHeader("Global Params", NULL, true, true);
+    changed |= ImGui::SliderFloat("processing rate", &gui.rate, 10, 240);
+    changed |= ImGui::SliderFloat("pos smoothing", &gui.pos_smoothing, 0, 1);
+    changed |= ImGui::SliderFloat("vel smoothing", &gui.vel_smoothing, 0, 1);
+    changed |= ImGui::SliderFloat("spring strength", &gui.spring_strength, 0, 1);
+    changed |= ImGui::SliderFloat("spring damping", &gui.spring_damping, 0, 1);
+    changed |= ImGui::SliderInt("kill frame count", &gui.kill_frame_count, 0, 200);
+    changed |= ImGui::SliderFloat("match distance", &gui.max_distance, 0.05, 2);
+    changed |= ImGui::SliderInt("track lost frames", &gui.lost_frames, 0, 200);
+    changed |= ImGui::SliderFloat("fusion process noise", &gui.process_noise, 0, 200);
+    changed |= ImGui::SliderFloat("fusion measurement noise", &gui.measurement_noise, 0, 0.01, "%.5f");
+    changed |= ImGui::SliderFloat("fusion range ref", &gui.range_ref, 0.5, 5);
+    changed |= ImGui::Checkbox("jitter buffer", &gui.jitter_buffer);
+    changed |= ImGui::SliderFloat("jitter mult", &gui.jitter_mult, 0, 5);
+    changed |= ImGui::SliderFloat("jitter min delay (ms)", &gui.jitter_min_delay, 0, 100);
+    changed |= ImGui::SliderFloat("jitter max delay (ms)", &gui.jitter_max_delay, 0, 200);
+
+    if(ImGui::Button("add receiver")) {
+        gui.num_receivers++;
+        changed = true;
+    }
+    ImGui::SameLine();
+    if(ImGui::Button("remove receiver") && gui.num_receivers > 1) {
+        gui.num_receivers--;
+        changed = true;
+    }
+
+    for(int i=0; i<gui.receivers.size(); i++) changed |= Receiver::drawGui(i + 1, gui.receivers[i], gui.receiver_status[i]);
+
+    changed |= Reducer::drawGui(gui.reductions);
+    changed |= Predictor::drawGui(gui.prediction, gui.prediction_ahead);
+    for(int i=0; i<gui.outputs.size(); i++) changed |= OscSender::drawGui(gui.output_names[i], gui.outputs[i], gui.output_status[i]);
+    changed |= SharedSender::drawGui(gui.shared_memory, gui.shared_memory_status);
+
+    // the recorder isn't the pipeline's, it's read from here
+    ImGui::CollapsingHeader("Record / Replay", NULL, true, true);
+    if(recorder.isRecording()) {
+        if(ImGui::Button("stop recording")) gui.stop_recording = changed = true;
+        ImGui::Text((recorder.getPath() + ": " + ofToString(recorder.numRecords()) + " datagrams, " + ofToString(recorder.numBytes() / 1024) + "KB").c_str());
+    } else if(ImGui::Button("record")) {
+        gui.record = changed = true;
+    }
+    ImGui::InputText("replay file", replay_path, sizeof(replay_path));
+    if(!gui.replaying) {
+        if(ImGui::Button("replay")) gui.replay = changed = true;
+    } else if(ImGui::Button("stop replay")) {
+        gui.stop_replay = changed = true;
+    }
+    ImGui::SameLine();
+    changed |= ImGui::Checkbox("paused", &gui.replay_paused);
+    ImGui::SameLine();
+    if(ImGui::Button("step")) {
+        gui.replay_steps++;
+        changed = true;
+    }
+    changed |= ImGui::Checkbox("as fast as possible", &gui.replay_fast);
+    ImGui::SameLine();
+    changed |= ImGui::Checkbox("loop", &gui.replay_loop);
+    changed |= ImGui::SliderFloat("replay speed", &gui.replay_speed, 0.1, 10);
+    if(gui.replaying) ImGui::Text(gui.replay_status.c_str());
+
+    // show stats
+    ImGui::CollapsingHeader("Processing Stats", NULL, true, true);
+    ImGui::Text(gui.stats.c_str());
+
+    if(!changed) return;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        setGuiState(gui);
+    }
+
+    // the files are opened and closed with the pipeline unlocked
+    if(gui.stop_recording) stopRecording();
+    else if(gui.record) startRecording();
+    if(gui.stop_replay) stopReplay();
+    else if(gui.replay) startReplay(replay_path);
+
+    // done, until they're pressed again
+    gui.record = gui.stop_recording = gui.replay = gui.stop_replay = false;
+    gui.replay_steps = 0;
+}
+
+
+void Pipeline::getGuiState(GuiState& gui) {
+    gui.rate = rate;
+    gui.pos_smoothing = Receiver::pos_smoothing;
+    gui.vel_smoothing = Receiver::vel_smoothing;
+    gui.spring_strength = Receiver::spring_strength;
+    gui.spring_damping = Receiver::spring_damping;
+    gui.kill_frame_count = Receiver::kill_frame_count;
+    gui.max_distance = Associator::max_distance;
+    gui.lost_frames = Associator::lost_frames;
+    gui.process_noise = Associator::process_noise;
+    gui.measurement_noise = Associator::measurement_noise;
+    gui.range_ref = Associator::range_ref;
+    gui.jitter_buffer = Receiver::jitter_buffer;
+    gui.jitter_mult = Receiver::jitter_mult;
+    gui.jitter_min_delay = Receiver::jitter_min_delay;
+    gui.jitter_max_delay = Receiver::jitter_max_delay;
+
+    gui.num_receivers = receivers.size();
+    gui.receivers.resize(receivers.size());
+    gui.receiver_status.resize(receivers.size());
+    for(int i=0; i<receivers.size(); i++) {
+        gui.receivers[i] = receivers[i]->getParams();
+        gui.receiver_status[i] = receivers[i]->getStatus(now_micros);
+    }
+
+    gui.reductions = reducer.getReductions();
+    gui.prediction = predictor.getParams();
+    gui.prediction_ahead = predictor.getAhead();
+
+    gui.outputs.resize(osc_senders.size());
+    gui.output_names.resize(osc_senders.size());
+    gui.output_status.resize(osc_senders.size());
+    for(int i=0; i<osc_senders.size(); i++) {
+        gui.outputs[i] = osc_senders[i]->getParams();
+        gui.output_names[i] = osc_senders[i]->name;
+        gui.output_status[i] = osc_senders[i]->getStatus();
+    }
+
+    gui.shared_memory = shared_sender.enabled;
+    gui.shared_memory_status = shared_sender.getStatus();
+
+    gui.replay_speed = replay_speed;
+    gui.replay_fast = replay_fast;
+    gui.replay_paused = replay_paused;
+    gui.replay_loop = replay_loop;
+    gui.record = gui.stop_recording = gui.replay = gui.stop_replay = false;
+    gui.replay_steps = 0;
+
+    gui.replaying = replay.isOpen();
+    if(gui.replaying) gui.replay_status = "Replaying " + ofToString((now_micros - replay_start) / 1e6f, 1) + " / " + ofToString(replay.getDuration() / 1e6f, 1) + "s, " + ofToString(replay.numPlayed()) + " / " + ofToString(replay.numRecords()) + " datagrams";
+
+    stringstream str;
+    str << "Receivers: " << receivers.size() << " on " << pool.numThreads() << " threads" << endl;
+    str << "Tick: " << ofToString(tick_millis, 3) << "ms at " << rate << "Hz";
+    gui.stats = str.str();
+    gui.num_sets = gui_sets;
+}
+
+
+void Pipeline::setGuiState(const GuiState& gui) {
+    gui_sets++;
+    rate = gui.rate;
+    Receiver::pos_smoothing = gui.pos_smoothing;
+    Receiver::vel_smoothing = gui.vel_smoothing;
+    Receiver::spring_strength = gui.spring_strength;
+    Receiver::spring_damping = gui.spring_damping;
+    Receiver::kill_frame_count = gui.kill_frame_count;
+    Associator::max_distance = gui.max_distance;
+    Associator::lost_frames = gui.lost_frames;
+    Associator::process_noise = gui.process_noise;
+    Associator::measurement_noise = gui.measurement_noise;
+    Associator::range_ref = gui.range_ref;
+    Receiver::jitter_buffer = gui.jitter_buffer;
+    Receiver::jitter_mult = gui.jitter_mult;
+    Receiver::jitter_min_delay = gui.jitter_min_delay;
+    Receiver::jitter_max_delay = gui.jitter_max_delay;
+
+    // safe here, the snapshot has its own copies of the persons. a receiver just added keeps its defaults
+    for(int i=0; i<receivers.size() && i<gui.receivers.size(); i++) receivers[i]->setParams(gui.receivers[i]);
+    if(gui.num_receivers != receivers.size()) setNumReceivers(gui.num_receivers);
+
+    reducer.setReductions(gui.reductions);
+    predictor.setParams(gui.prediction);
+    for(int i=0; i<osc_senders.size() && i<gui.outputs.size(); i++) osc_senders[i]->setParams(gui.outputs[i]);
+    shared_sender.setEnabled(gui.shared_memory);
+
+    replay_speed = gui.replay_speed;
+    replay_fast = gui.replay_fast;
+    replay_paused = gui.replay_paused;
+    replay_loop = gui.replay_loop;
+    replay_steps += gui.replay_steps;
+}
+#endif
+
+}
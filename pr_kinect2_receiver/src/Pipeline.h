@@ -0,0 +1,221 @@
+/*
+ All of the processing, on its own thread at a fixed rate, whatever the display is doing
+ - receivers (in parallel), association and fusion, reduction, prediction, osc and shared memory out, every tick
+ - loading / saving settings lock the pipeline for as long as they touch it, settings reloaded while running are
+   parsed elsewhere and swapped in between two ticks
+ - draw() and drawGui() only ever read the last published Snapshot, which never blocks either side. the GUI edits
+   a copy of the params in it, and only locks to put them back when something changed
+ - recordings and replays are opened and closed with the pipeline unlocked, only the open file is swapped in
+ - can record all incoming datagrams, and replay a recording instead of the sockets: the replay is played on the
+   pipeline's own clock, one tick period per tick, so it comes out the same whether it's run slower, faster or stepped
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "Receiver.h"
+#include "Association.h"
+#include "Reduction.h"
+#include "Prediction.h"
+#include "ThreadPool.h"
+#include "OscSender.h"
+#include "SharedSender.h"
+#include "TripleBuffer.h"
+#include "Telemetry.h"
+#include "PacketLog.h"
+
+namespace pr {
+
+#ifndef PR_HEADLESS
+// what the GUI shows and edits, see Pipeline::drawGui
+struct GuiState {
+    float rate;
+    float pos_smoothing;
+    float vel_smoothing;
+    float spring_strength;
+    float spring_damping;
+    int kill_frame_count;
+    float max_distance;
+    int lost_frames;
+    float process_noise;
+    float measurement_noise;
+    float range_ref;
+    bool jitter_buffer;
+    float jitter_mult;
+    float jitter_min_delay;
+    float jitter_max_delay;
+    vector<Receiver::Params> receivers;
+    vector<Reduction> reductions;
+    Predictor::Params prediction;
+    vector<OscSender::Params> outputs;
+    bool shared_memory;
+    float replay_speed;
+    bool replay_fast;
+    bool replay_paused;
+    bool replay_loop;
+
+    // buttons, done when it's put back
+    int num_receivers;
+    bool record;
+    bool stop_recording;
+    bool replay;
+    bool stop_replay;
+    int replay_steps;
+
+    // shown only
+    vector<string> receiver_status;
+    vector<string> output_names;
+    vector<string> output_status;
+    string shared_memory_status;
+    float prediction_ahead;
+    bool replaying;
+    string replay_status;
+    string stats;
+
+    uint64_t num_sets;              // how many changes from the GUI were in when this was filled in
+};
+#endif
+
+
+// copy of what there is to draw, published once per tick
+struct Snapshot {
+    struct Sensor {
+        bool enabled;
+        ofMatrix4x4 matrix;         // global transform of the sensor
+        ofQuaternion floor_quat;
+    };
+
+    vector<Person> persons_all;
+    vector<Person> persons_reduced;
+    vector<Sensor> sensors;
+
+    int num_unique = 0;
+    int num_tracks = 0;
+    float associator_millis = 0;
+    float tick_millis = 0;          // time the whole tick took
+
+#ifndef PR_HEADLESS
+    // filled in only when drawGui() asked for it since the last tick, so the status text is built as often as it's drawn
+    bool has_gui = false;
+    GuiState gui;
+#endif
+};
+
+
+class Pipeline : public ofThread {
+public:
+    static float rate;              // ticks per second
+
+    // replay options, can be changed while replaying
+    float replay_speed = 1;         // 1 is real time
+    bool replay_fast = false;       // as fast as the ticks run (up to 2000 a second), whatever replay_speed
+    bool replay_paused = false;     // only steps
+    bool replay_loop = false;
+
+    ~Pipeline();
+
+    // call once before loading settings
+    void setup();
+
+    void start();
+    void stop();
+
+    // both lock the pipeline
+    void loadFromXml(ofXml& xml);
+    void saveToXml(ofXml& xml);
+
+    // settings parsed elsewhere (see ConfigWatcher), applied by the pipeline's thread between two ticks. never blocks.
+    // receivers, sockets and persons are kept, only ports and outputs that changed are reopened
+    void queueXml(shared_ptr<ofXml> xml);
+
+    // all incoming datagrams to path (in data), "" for a new timestamped file in recordings/
+    bool startRecording(const string& path = "");
+    void stopRecording();
+
+    // these lock the pipeline, after opening / before closing the file. the sockets are ignored while replaying,
+    // back to them when it ends (unless it loops)
+    bool startReplay(const string& path);
+    void stopReplay();
+    void stepReplay();              // one tick, when paused
+    bool isReplaying();
+
+    // newest published state, for drawing. never blocks (only call from one thread)
+    const Snapshot& getSnapshot()   { return snapshots.front(); }
+
+#ifndef PR_HEADLESS
+    // params, receivers, senders and stats, from snapshot (getSnapshot()). only locks the pipeline if something changed
+    void drawGui(const Snapshot& snapshot);
+#endif
+
+protected:
+    // receives the datagrams for all receivers (declared first, so it outlives them)
+    NetworkThread network;
+
+    // the receivers, one per <receiver> in settings
+    vector<Receiver::Ptr> receivers;
+
+    // runs the receivers in parallel
+    ThreadPool pool;
+
+    // the persons
+    vector<Person::Ptr> persons_global_reduced;     // list of final, condensed persons, one per output slot (NULL if a slot has no one)
+    vector<Person::Ptr> persons_global_all;         // list of all persons from all receivers
+    vector<Person::Ptr> persons_global_unique;      // one per physical person, persons seen by several receivers merged
+
+    // matches up persons seen by several receivers
+    Associator associator;
+
+    // works out the output slots
+    Reducer reducer;
+
+    // moves them ahead to make up for the latency
+    Predictor predictor;
+
+    // osc, one per <output> in settings
+    vector<OscSender::Ptr> osc_senders;
+
+    // same machine consumers
+    SharedSender shared_sender;
+
+    TripleBuffer<Snapshot> snapshots;
+    float tick_millis = 0;
+
+    // record / replay
+    PacketRecorder recorder;
+    PacketReplay replay;
+    uint64_t now_micros = 0;        // the time of this tick, ofGetElapsedTimeMicros() or the replay clock
+    uint64_t replay_start = 0;      // now_micros at the start of the log
+    int replay_steps = 0;           // requested while paused
+    char replay_path[512] = "";     // the GUI thread's
+
+    // from queueXml(), waiting for the next tick
+    std::mutex queued_mutex;
+    shared_ptr<ofXml> queued_xml;
+
+#ifndef PR_HEADLESS
+    atomic<bool> gui_wanted { false };  // drawGui() wants the next snapshot to have a GuiState
+    uint64_t gui_sets = 0;              // setGuiState() calls, only made by the GUI thread (with the pipeline locked)
+    GuiState gui_state;                 // the GUI thread's copy, drawn and edited
+    bool has_gui_state = false;
+
+    void getGuiState(GuiState& gui);
+    void setGuiState(const GuiState& gui);
+#endif
+
+    void threadedFunction() override;
+    void setNumReceivers(int count);
+    void setNumOutputs(int count);
+    void applyXml(ofXml& xml);      // with the pipeline locked
+
+    // one step of dt seconds. called with the pipeline locked
+    void tick(float dt);
+    uint64_t tickWait(uint64_t period);
+    void beginReplay(PacketReplay& opened);
+    void endReplay(PacketReplay& closed);
+    void playReplay(float dt);
+    void reduce();
+    void sendOsc(float dt);
+    void publish();
+};
+
+}
@@ -0,0 +1,129 @@
+
+#include "Prediction.h"
+
+#ifndef PR_HEADLESS
+#include "ofxImGui.h"
+#endif
+
+namespace pr {
+
+const char* const Predictor::kGroupNames[kNumGroups] = { "core", "limbs", "extremities" };
+
+
+Predictor::Predictor() : slots(Reducer::kMaxSlots) {
+}
+
+
+void Predictor::predict(vector<Person::Ptr>& persons, const vector<uint32_t>& keys, int64_t delay, float dt) {
+    if(!enabled) {
+        for(auto&& slot : slots) slot.valid = false;
+        ahead = 0;
+        return;
+    }
+
+    ahead = latency + (measure_delay ? delay / 1000.0f : 0);
+    float t = ahead / 1000.0f;
+    float smoothing = rateSmoothing(acc_smoothing, dt);
+    for(int j=0; j<kNumJoints; j++) joint_max_offset[j] = max_offset[kJointGroups[j]];
+    const JointSchema& schema = JointSchema::get();
+
+    for(int i=0; i<slots.size(); i++) {
+        Slot& slot = slots[i];
+        if(i >= persons.size() || i >= keys.size() || !persons[i]) {
+            slot.valid = false;
+            continue;
+        }
+        const Joints& joints = persons[i]->joints;
+
+        // someone else in this slot (or an average of someone else), their acceleration starts over
+        if(!slot.valid || slot.key != keys[i]) {
+            slot.key = keys[i];
+            slot.valid = true;
+            for(int j=0; j<kNumJoints; j++) {
+                slot.last_vel[j] = joints.vel[j];
+                slot.acc[j].set(0, 0, 0);
+            }
+        } else {
+            accelArray(slot.acc[0].getPtr(), slot.last_vel[0].getPtr(), joints.vel[0].getPtr(), kNumJoints * 3, dt, smoothing);
+        }
+
+        // persons are plain arrays, copying doesn't allocate
+        slot.person = *persons[i];
+        Joints& predicted = slot.person.joints;
+        predictArray(predicted.pos, joints.pos, joints.vel, slot.acc, joint_max_offset, kNumJoints, t, acc_amount);
+        predictArray(predicted.springy_pos, joints.springy_pos, joints.vel, slot.acc, joint_max_offset, kNumJoints, t, acc_amount);
+        parentVectorArray(predicted.vec, predicted.pos, schema.parents, kNumJoints);
+
+        persons[i] = &slot.person;
+    }
+}
+
+
+Predictor::Params Predictor::getParams() const {
+    Params params;
+    params.enabled = enabled;
+    params.latency = latency;
+    params.measure_delay = measure_delay;
+    params.acc_smoothing = acc_smoothing;
+    params.acc_amount = acc_amount;
+    for(int g=0; g<kNumGroups; g++) params.max_offset[g] = max_offset[g];
+    return params;
+}
+
+
+void Predictor::setParams(const Params& params) {
+    enabled = params.enabled;
+    latency = params.latency;
+    measure_delay = params.measure_delay;
+    acc_smoothing = params.acc_smoothing;
+    acc_amount = params.acc_amount;
+    for(int g=0; g<kNumGroups; g++) max_offset[g] = params.max_offset[g];
+}
+
+
+void Predictor::loadFromXml(ofXml& xml) {
+	if (!xml.exists("//Settings/Prediction")) return;
+	xml.setTo("//Settings/Prediction");
+	enabled = xml.getBoolValue("enabled");
+	latency = xml.getFloatValue("latency");
+	measure_delay = xml.getBoolValue("measure_delay");
+	acc_smoothing = xml.getFloatValue("acc_smoothing");
+	acc_amount = xml.getFloatValue("acc_amount");
+	for (int g=0; g<kNumGroups; g++) {
+		string name = string("max_offset/") + kGroupNames[g];
+		if (xml.exists(name)) max_offset[g] = xml.getFloatValue(name);
+	}
+}
+
+
+void Predictor::saveToXml(ofXml& xml) const {
+	xml.setTo("//Settings");
+	xml.addChild("Prediction");
+	xml.setTo("Prediction");
+	xml.addValue("enabled", ofToString(enabled));
+	xml.addValue("latency", ofToString(latency));
+	xml.addValue("measure_delay", ofToString(measure_delay));
+	xml.addValue("acc_smoothing", ofToString(acc_smoothing));
+	xml.addValue("acc_amount", ofToString(acc_amount));
+	xml.addChild("max_offset");
+	xml.setTo("max_offset");
+	for (int g=0; g<kNumGroups; g++) xml.addValue(kGroupNames[g], ofToString(max_offset[g]));
+}
+
+
+#ifndef PR_HEADLESS
+bool Predictor::drawGui(Params& params, float ahead) {
+    bool changed = false;
+    ImGui::CollapsingHeader("Prediction", NULL, true, true);
+    changed |= ImGui::Checkbox("predict", &params.enabled);
+    changed |= ImGui::SliderFloat("latency (ms)", &params.latency, 0, 200);
+    changed |= ImGui::Checkbox("add jitter buffer delay", &params.measure_delay);
+    changed |= ImGui::SliderFloat("acc smoothing", &params.acc_smoothing, 0, 1);
+    changed |= ImGui::SliderFloat("acc amount", &params.acc_amount, 0, 1);
+    for(int g=0; g<kNumGroups; g++) changed |= ImGui::SliderFloat((string("max offset ") + kGroupNames[g] + " (m)").c_str(), &params.max_offset[g], 0, 1);
+    ImGui::Text(("ahead: " + ofToString(ahead, 1) + "ms").c_str());
+    return changed;
+}
+#endif
+
+}
@@ -0,0 +1,118 @@
+/*
+ Moves the output persons ahead to where they'll be by the time whoever receives them sees them
+ - latency: the sensor and network part can't be seen from here, so it's configured. the receivers are sampled
+   behind now by the jitter buffer delay, which is known exactly every tick and added if measure_delay
+ - each joint moves by vel * t + acc * t^2 / 2. vel is the fused (kalman) velocity, acc its change between ticks,
+   smoothed as it's noisy, and started over when a slot changes person (or an average changes who's in it)
+ - how far a joint may be moved is clamped per joint group, the core hardly gets ahead of itself while
+   hands and feet turn around quickly and are allowed more
+ - works on copies in its own slots, so the fused persons (and shared memory) are left as they were
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "Person.h"
+#include "Reduction.h"
+
+namespace pr {
+
+enum JointGroup {
+    kGroupCore,         // spine, head, hips
+    kGroupLimbs,        // shoulders, elbows, knees
+    kGroupExtremities,  // wrists, hands, ankles, feet
+    kNumGroups
+};
+
+// JointGroup of each JointIndex
+static const int kJointGroups[kNumJoints] = {
+    kGroupCore, kGroupCore, kGroupCore, kGroupCore,                             // waist torso neck head
+    kGroupLimbs, kGroupLimbs, kGroupExtremities, kGroupExtremities,             // l shoulder elbow wrist hand
+    kGroupLimbs, kGroupLimbs, kGroupExtremities, kGroupExtremities,             // r
+    kGroupCore, kGroupLimbs, kGroupExtremities, kGroupExtremities,              // l hip knee ankle foot
+    kGroupCore, kGroupLimbs, kGroupExtremities, kGroupExtremities,              // r
+    kGroupCore, kGroupExtremities, kGroupExtremities, kGroupExtremities, kGroupExtremities  // c_shoulder, hand tips, thumbs
+};
+
+
+// acc += ((vel - last_vel) / dt - acc) * (1 - smoothing), last_vel = vel. n floats
+inline void accelArray(float* __restrict acc, float* __restrict last_vel, const float* __restrict vel, int n, float dt, float smoothing) {
+    float k = (1 - smoothing) / max(dt, 0.0001f);
+    float s = 1 - smoothing;
+    for(int i=0; i<n; i++) {
+        acc[i] += (vel[i] - last_vel[i]) * k - acc[i] * s;
+        last_vel[i] = vel[i];
+    }
+}
+
+// out = pos + vel * t + acc * acc_amount * t^2 / 2, each joint's offset clamped to max_offset of it. n joints
+inline void predictArray(ofVec3f* __restrict out, const ofVec3f* __restrict pos, const ofVec3f* __restrict vel, const ofVec3f* __restrict acc, const float* __restrict max_offset, int n, float t, float acc_amount) {
+    float h = 0.5f * t * t * acc_amount;
+    for(int i=0; i<n; i++) {
+        float x = vel[i].x * t + acc[i].x * h;
+        float y = vel[i].y * t + acc[i].y * h;
+        float z = vel[i].z * t + acc[i].z * h;
+        float len2 = x * x + y * y + z * z;
+        float m = max_offset[i];
+        float s = len2 > m * m ? m / sqrtf(len2) : 1;
+        out[i].x = pos[i].x + x * s;
+        out[i].y = pos[i].y + y * s;
+        out[i].z = pos[i].z + z * s;
+    }
+}
+
+
+class Predictor {
+public:
+    static const char* const kGroupNames[kNumGroups];
+
+    bool enabled = false;
+    float latency = 60;             // (ms) sensor and network, on top of what the pipeline knows it runs behind
+    bool measure_delay = true;      // add the jitter buffer delay, every tick
+    float acc_smoothing = 0.8;      // per frame at kReferenceFps
+    float acc_amount = 1;           // 0 for velocity only
+    float max_offset[kNumGroups] = { 0.1, 0.2, 0.3 };   // (m) furthest a joint of each group is moved
+
+    Predictor();
+
+    // slots in, slots out (pointing at the predictor's copies). keys: who's in each slot (Reducer::getSlotKeys()).
+    // delay: how far behind now the receivers were sampled (micros)
+    void predict(vector<Person::Ptr>& persons, const vector<uint32_t>& keys, int64_t delay, float dt);
+
+    // how far ahead the last predict() went (ms)
+    float getAhead() const  { return ahead; }
+
+    // what the gui edits (see Pipeline::drawGui)
+    struct Params {
+        bool enabled;
+        float latency;
+        bool measure_delay;
+        float acc_smoothing;
+        float acc_amount;
+        float max_offset[kNumGroups];
+    };
+    Params getParams() const;
+    void setParams(const Params& params);
+
+    void loadFromXml(ofXml& xml);
+    void saveToXml(ofXml& xml) const;
+#ifndef PR_HEADLESS
+    // ahead: from getAhead(). no predictor needed. true if params changed
+    static bool drawGui(Params& params, float ahead);
+#endif
+
+protected:
+    struct Slot {
+        uint32_t key = 0;
+        bool valid = false;         // last_vel and acc are this person's
+        ofVec3f last_vel[kNumJoints];
+        ofVec3f acc[kNumJoints];
+        Person person;              // the predicted copy
+    };
+
+    vector<Slot> slots;             // Reducer::kMaxSlots, never resized
+    float joint_max_offset[kNumJoints];
+    float ahead = 0;
+};
+
+}
@@ -1,6 +1,9 @@
 
 #include "Receiver.h"
+
+#ifndef PR_HEADLESS
 #include "ofxImGui.h"
+#endif
 
 namespace pr {
 
@@ -8,197 +11,408 @@ float Receiver::pos_smoothing = 0.5;
 float Receiver::vel_smoothing = 0.96;
 float Receiver::spring_strength = 0.02;
 float Receiver::spring_damping = 0.05;
-int Receiver::kill_frame_count = 10;      // kill person afer this many frames of not receiving
+int Receiver::kill_frame_count = 10;      // kill person afer this many frames (at kReferenceFps) of not receiving
+bool Receiver::jitter_buffer = true;
+float Receiver::jitter_mult = 2;
+float Receiver::jitter_min_delay = 0;
+float Receiver::jitter_max_delay = 100;
 
 
 void Receiver::initOsc() {
-    ofLogNotice() << "Receiver " << _index << " initing oscReceiver on port " << _port;
-    if(!oscReceiver) oscReceiver = make_unique<ofxOscReceiver>();
-    oscReceiver->setup(_port);
+    ofLogNotice() << "Receiver " << _index << " listening on port " << _port;
+    network.remove(&queue);
+    _isListening = network.add(_port, &queue);
+    _lastListenTime = ofGetElapsedTimef();
 }
 
 
 
 void Receiver::parseOsc() {
-    if(!oscReceiver) initOsc();
+    // (re)try binding once a second if the port wasn't available
+    if(!_isListening && (_lastListenTime < 0 || ofGetElapsedTimef() - _lastListenTime > 1)) initOsc();
+
+    // parse incoming OSC, a datagram (i.e. a tracker frame) at a time, into the jitter buffer.
+    // if we've fallen behind further than the buffer reaches back, only the newest datagrams
+    // waiting are buffered, older ones only get their events (e.g. /lost_user) applied. so catching
+    // up costs a few frames however big the backlog. datagrams arriving meanwhile are left for next update
+    int keep = jitter_buffer ? JitterBuffer::kCapacity : 1;
+    int pending = queue.size();
+    int num_datagrams = 0;
+    int num_bytes = 0;
+    _numMessagesParsed = 0;
+    for(; pending > 0; pending--) {
+        const Packet* p = queue.front();
+        num_datagrams++;
+        num_bytes += p->size;
+        bool events_only = pending > keep;
+        if(events_only) _numShedPackets++;
+        health.onPacket(p->arrival_micros, p->size);
+
+        frame = &buffer.beginWrite();
+        frame->arrival_micros = p->arrival_micros;
+
+        try {
+            osc::ReceivedPacket packet(p->data, p->size);
+            uint64_t timetag = 0;
+            if(packet.IsBundle()) {
+                osc::ReceivedBundle bundle(packet);
+                timetag = bundle.TimeTag();
+                parseBundle(bundle, events_only);
+            } else {
+                parseMessage(osc::ReceivedMessage(packet), events_only);
+            }
 
-    // parse incoming OSC
-    while(oscReceiver->hasWaitingMessages()) {
-        _isConnected = true;
+            // shed ones too, they did arrive
+            if(frame->frame_id >= 0 || !frame->isEmpty()) health.onFrame(p->arrival_micros, frame->frame_id, frame->capture_micros, timetag, buffer.getInterval());
 
-		ofxOscMessage m;
-		oscReceiver->getNextMessage(m);
+            // whole datagram read, it's a frame now
+            if(!events_only && !frame->isEmpty()) buffer.commit();
+        } catch(osc::Exception& e) {
+            // malformed packet, drop the rest of it (and the frame it was carrying)
+            health.onMalformed(p->arrival_micros);
+            ofLogVerbose() << "Receiver::parseOsc malformed packet on port " << _port << ": " << e.what();
+        }
+        queue.pop();
+        frame = NULL;
+
+        // DONT DO SMOOTHING, SPRINGYNESS ETC. HERE SHOULD BE AT FIXED FPS EVERY FRAME, WHETHER DATA COMES IN OR NOT
+    }
 
-		if (strstr(m.getAddress().c_str(), "/skel/")) {
+    // once per update, not per message, the atomics are shared with the other receivers' threads
+    if(num_datagrams) {
+        Telemetry& telemetry = Telemetry::get();
+        telemetry.count(kCounterDatagramsIn, num_datagrams);
+        telemetry.count(kCounterBytesIn, num_bytes);
+        telemetry.count(kCounterMessagesIn, _numMessagesParsed);
+    }
+}
 
-			// should get something like splitAddress = ["", "skel", "0", "c_shoulder"]
-			vector<string> splitAddress = ofSplitString(m.getAddress(), "/");
 
-            // assume we're parsing person with id == user_id
-            int user_id = ofToInt(splitAddress[2]);
+void Receiver::parseBundle(const osc::ReceivedBundle& bundle, bool events_only) {
+    for(auto it = bundle.ElementsBegin(); it != bundle.ElementsEnd(); ++it) {
+        if(it->IsBundle()) parseBundle(osc::ReceivedBundle(*it), events_only);
+        else parseMessage(osc::ReceivedMessage(*it), events_only);
+    }
+}
 
-			// if new user found and calibrated, add to map
-			if (!persons[user_id]) {
-				ofLogWarning() << "Receiver::parseOsc creating person " << user_id;
-				persons[user_id] = make_shared<Person>();
-			}
 
-            // this is the person we're receiving info for
-            Person::Ptr person = persons[user_id];
+void Receiver::parseMessage(const osc::ReceivedMessage& m, bool events_only) {
+    static const OscRouter router;
 
-            // whether it's new user or existing user, update joint details
+    _numMessagesParsed++;
 
+    OscRoute route;
+    if(!router.route(m.AddressPattern(), route)) return;   // not for us
 
-            // reset alive counter
-            person->alive_counter = 0;
+    // state that a newer datagram will overwrite anyway
+    if(events_only && (route.type == OscRoute::kSkel || route.type == OscRoute::kFloorPlane)) {
+        _numShedMessages++;
+        return;
+    }
 
-            // read from osc:
-			string jointName = splitAddress[3];
-			float confidence = m.getArgAsFloat(3);
-			ofVec3f pos = ofVec3f(m.getArgAsFloat(0), m.getArgAsFloat(1), m.getArgAsFloat(2));
-			ofQuaternion quat = ofQuaternion(m.getArgAsFloat(4), m.getArgAsFloat(5), m.getArgAsFloat(6), m.getArgAsFloat(7));
-			ofVec3f euler = quat.getEuler();
-			ofVec3f vel = ofVec3f(m.getArgAsFloat(8), m.getArgAsFloat(9), m.getArgAsFloat(10));
-            //        float speed;  // DON"T READ SPEED FROM OSC
+    // check arguments before reading any, so a bad message can't read past the end
+    if(!OscRouter::validate(route.type, m.TypeTags())) {
+        health.onMalformed(frame->arrival_micros);
+        ofLogVerbose() << "Receiver::parseMessage wrong arguments for " << m.AddressPattern() << " on port " << _port;
+        return;
+    }
 
+    osc::ReceivedMessageArgumentIterator arg = m.ArgumentsBegin();
 
-            // apply world transformation to pos, quat and vel
-			ofVec4f tempPos = ofVec4f(pos.x, pos.y, pos.z, 1.0);
-			pos = tempPos*node.getGlobalTransformMatrix();
-			ofVec4f tempVel = ofVec4f(vel.x, vel.y, vel.z, 0.0);    // 0 for w because we don't want transformation
-			vel = tempVel*node.getGlobalTransformMatrix();
-			quat *= node.getGlobalOrientation();
+    switch(route.type) {
+    case OscRoute::kSkel: {
+        // collect into the frame, persons are only touched in commitFrame() when it's sampled
+        SensorFrame::Body* body = frame->getBody(route.user_id);
+        if(!body) {
+            ofLogError() << "Receiver::parseMessage too many bodies in one frame, max is " << SensorFrame::kMaxBodies;
+            return;
+        }
 
+        float a[11];
+        for(int i=0; i<11; i++) a[i] = (arg++)->AsFloatUnchecked();
+
+        int j = route.joint;
+        body->pos[j].set(a[0], a[1], a[2]);
+        body->confidence[j] = a[3];
+        body->quat[j].set(a[4], a[5], a[6], a[7]);
+        body->vel[j].set(a[8], a[9], a[10]);
+        body->joint_mask |= 1u << j;
+        //        float speed;  // DON"T READ SPEED FROM OSC
+        break;
+    }
 
+    case OscRoute::kLostUser: {
+        // if person is deleted (user_lost) remove from pool
+        int user_id = arg->AsInt32Unchecked();
+        ofLogWarning() << "Receiver::parseMessage delete person " << user_id;
+        removePerson(user_id);
+        buffer.removeUser(user_id);
+        break;
+    }
 
-            // write to joint
-            person->joints[jointName].confidence = confidence;
-            person->joints[jointName].pos.target = pos;
-            person->joints[jointName].quat = quat;
-            person->joints[jointName].euler = euler;
+    case OscRoute::kFloorPlane: {
+        float a[4];
+        for(int i=0; i<4; i++) a[i] = (arg++)->AsFloatUnchecked();
+        frame->floor.set(a[0], a[1], a[2], a[3]);
+        frame->has_floor = true;
+        break;
+    }
 
-            // only use velocity if we're confident, otherwise zero
-            person->joints[jointName].vel.target = (confidence > 0.5) ? vel : ofVec3f(0);
+    case OscRoute::kFrame: {
+        frame->frame_id = (arg++)->AsInt32Unchecked();
+        frame->capture_micros = (arg++)->AsInt64Unchecked();
+        break;
+    }
+
+    default:
+        // known, but nothing we use yet
+        break;
+    }
+}
+
+
+void Receiver::commitFrame(const SensorFrame& frame) {
+    ofMatrix4x4 matrix = node.getGlobalTransformMatrix();
+    ofQuaternion orientation = node.getGlobalOrientation();
+
+    // sensor space -> world space, once per sampled frame for everything in it
+    ofVec3f pos[kNumJoints];
+    ofVec3f vel[kNumJoints];
+
+    for(int b=0; b<frame.num_bodies; b++) {
+        const SensorFrame::Body& body = frame.bodies[b];
+
+        // this is the person we're receiving info for
+        Person::Ptr person = findPerson(body.user_id);
+
+        // if new user found and calibrated, take one from the pool
+        if(!person) {
+            person = pool.acquire(body.user_id);
+            if(!person) {
+                ofLogError() << "Receiver::commitFrame no free persons for " << body.user_id << ", max is " << pool.capacity();
+                continue;
+            }
+            ofLogWarning() << "Receiver::commitFrame creating person " << body.user_id;
+            person->sensor = _index;
+            persons.push_back(person);
         }
 
-		else if (strstr(m.getAddress().c_str(), "/lost_user")) {
-			// if person is deleted (user_lost) remove from map
-			int user_id = m.getArgAsInt(0);
-			ofLogWarning() << "Receiver::parseOsc delete person " << user_id;
-			persons.erase(user_id);
-		}
+        // reset alive counter
+        person->alive_counter = 0;
 
-		else if (strstr(m.getAddress().c_str(), "/floorplane")) {
-			floorQuat = ofQuaternion(m.getArgAsFloat(0), m.getArgAsFloat(1), m.getArgAsFloat(2), m.getArgAsFloat(3));
-			floorQuat = floorQuat*node.getOrientationQuat();
-		}
+        transformArray(pos, body.pos, matrix, 1, kNumJoints);
+        transformArray(vel, body.vel, matrix, 0, kNumJoints);   // 0 for w because we don't want translation
 
-        // DONT DO SMOOTHING, SPRINGYNESS ETC. HERE SHOULD BE AT FIXED FPS EVERY FRAME, WHETHER DATA COMES IN OR NOT
+        // joints missing from the frame keep what they had
+        if(!body.isComplete()) _numIncomplete++;
+
+        Joints& joints = person->joints;
+        for(int j=0; j<kNumJoints; j++) {
+            if(!(body.joint_mask & (1u << j))) continue;
+            joints.confidence[j] = body.confidence[j];
+            joints.range[j] = body.pos[j].length();
+            joints.pos_target[j] = pos[j];
+            joints.quat[j] = body.quat[j] * orientation;
+
+            // only use velocity if we're confident, otherwise zero
+            if(body.confidence[j] > 0.5) joints.vel_target[j] = vel[j];
+            else joints.vel_target[j].set(0, 0, 0);
+        }
     }
 
+    if(frame.has_floor) {
+        floorQuat = ofQuaternion(frame.floor.x, frame.floor.y, frame.floor.z, frame.floor.w);
+        floorQuat = floorQuat*node.getOrientationQuat();
+    }
+}
+
+
+int64_t Receiver::getDelay() const {
+    if(!_enabled || !jitter_buffer) return 0;
+    return buffer.getDelay(jitter_mult, jitter_min_delay * 1000, jitter_max_delay * 1000);
 }
 
 
-void Receiver::update(vector<Person::Ptr>& persons_global) {
+void Receiver::update(int64_t target_micros, float dt) {
     // return if not _enabled
     if(!_enabled) {
-        _isConnected = false;
         _numPeople = 0;
-        persons.clear();
-        oscReceiver = NULL;
+        removeAllPersons();
+        if(_isListening) {
+            network.remove(&queue);
+            _isListening = false;
+            _lastListenTime = -1;
+            while(queue.front()) queue.pop();
+            buffer.clear();
+            health.clear();
+        }
         return;
     }
 
-
-    // clear flag
-    _isConnected = false;
-
     // check for Osc messages and update
-    parseOsc();
+    {
+        ScopedTimer timer(kStageParse);
+        parseOsc();
+    }
+
+    // apply the frame as it was at the target time
+    if(buffer.sample(target_micros, sampled)) {
+        ScopedTimer timer(kStageTransform);
+        commitFrame(sampled);
+    }
 
+    // the params are per frame at kReferenceFps, this update is this many of those
+    float steps = dt * kReferenceFps;
 
     // delete dead persons
-    for(auto it = persons.cbegin(); it != persons.cend(); ) {
-        if(!it->second || it->second->alive_counter >= kill_frame_count) {
-            persons.erase(it++);
+    for(auto it = persons.begin(); it != persons.end(); ) {
+        if((*it)->alive_counter * steps >= kill_frame_count) {
+            pool.release(*it);
+            it = persons.erase(it);
         } else {
             ++it;
         }
     }
 
 
+    ScopedTimer timer(kStageSmoothing);
+
     // do smoothing, springyness etc.
-    // iterate all persons
-    for(auto&& pkv : persons) {
-        auto person = pkv.second;
+    // each pass runs over all persons, on whole joint arrays at once (see Joints.h)
+    // the targets only change in commitFrame(), so every pass sees whole (sampled) tracker frames
+
+    // first pass: smoothings
+    float pos_k = rateSmoothing(pos_smoothing, dt);
+    float vel_k = rateSmoothing(vel_smoothing, dt);
+    for(auto person : persons) {
+        Joints& joints = person->joints;
+        smoothArray(joints.pos[0].getPtr(), joints.pos_target[0].getPtr(), kNumJoints * 3, pos_k);
+        smoothArray(joints.vel[0].getPtr(), joints.vel_target[0].getPtr(), kNumJoints * 3, vel_k);
+    }
 
-        if(person) {
-            // incremment alive counter
-            person->alive_counter++;
+    // second pass: speed, euler, springyness
+    for(auto person : persons) {
+        Joints& joints = person->joints;
 
-            // set person color
-            static ofColor colors[] = { ofColor::red, ofColor::green, ofColor::blue };
-            person->color = colors[_index-1];
+        // now set speed as magnitude of SMOOTHED velocity
+        lengthArray(joints.speed, joints.vel, kNumJoints);
 
-            // iterate all joints.
-            // first pass: smoothings, euler, springyness
-            for(auto&& jkv : person->joints) {
-                JointInfo& joint = jkv.second;
+        for(int j=0; j<kNumJoints; j++) joints.euler[j] = joints.quat[j].getEuler();
 
-                // smoothings
-                joint.pos.update(pos_smoothing);
-                joint.vel.update(vel_smoothing);
+        springArray(joints.springy_pos[0].getPtr(), joints.springy_vel[0].getPtr(), joints.pos[0].getPtr(), kNumJoints * 3, spring_strength, spring_damping, steps);
+    }
 
-                // now set speed as magnitude of SMOOTHED velocity
-                joint.speed = joint.vel.current.length();
+    // third pass: vectors to parent
+    // (do this in separate pass to above to make sure all joints have been smoothed first)
+    const JointSchema& schema = JointSchema::get();
+    for(auto person : persons) {
+        parentVectorArray(person->joints.vec, person->joints.pos, schema.parents, kNumJoints);
 
-                // get euler
-                joint.euler = joint.quat.getEuler();
+        // incremment alive counter
+        person->alive_counter++;
 
-                // springyness
-                ofVec3f diff = (joint.pos.current - joint.springy_pos);
-                joint.springy_vel = joint.springy_vel * (1 - spring_damping) + diff * spring_strength;
-                joint.springy_pos += joint.springy_vel;
-            }
+        // set person color
+        person->color = _color;
+    }
 
+    // set _numPeople
+    _numPeople = persons.size();
+}
 
-            // iterate all joints
-            // second pass: do vectors to parent
-            // (do this in separate pass to above to make sure all joints have been smoothed first)
-            for(auto&& jkv : person->joints) {
-                JointInfo& joint = jkv.second;
-                joint.vec = person->joints[joint.parentJointName].pos.current - joint.pos.current;
-            }
 
 
-            // add person to global list
-            persons_global.push_back(person);
+void Receiver::appendPersons(vector<Person::Ptr>& persons_global) const {
+    persons_global.insert(persons_global.end(), persons.begin(), persons.end());
+}
 
-        } else {
-            ofLogError() << "Receiver::update person == NULL";
+
+Person::Ptr Receiver::findPerson(int user_id) const {
+    for(auto person : persons) if(person->user_id == user_id) return person;
+    return NULL;
+}
+
+void Receiver::removePerson(int user_id) {
+    for(auto it = persons.begin(); it != persons.end(); ++it) {
+        if((*it)->user_id == user_id) {
+            pool.release(*it);
+            persons.erase(it);
+            return;
         }
     }
+}
 
-    // set _numPeople
-    _numPeople = persons.size();
+void Receiver::removeAllPersons() {
+    for(auto person : persons) pool.release(person);
+    persons.clear();
+}
+
+
+void Receiver::resetStream() {
+    while(queue.front()) queue.pop();
+    buffer.clear();
+    health.clear();
+    removeAllPersons();
+    _numPeople = 0;
 }
 
 
+Receiver::Params Receiver::getParams() const {
+    Params params;
+    params.enabled = _enabled;
+    params.port = _port;
+    params.pos = _pos;
+    params.rot = _rot;
+    return params;
+}
 
-void Receiver::drawGui() {
-    string str_index = ofToString(_index);
-    ImGui::CollapsingHeader(("Receiver " + str_index).c_str(), NULL, true, true);
-    ImGui::Checkbox(("Enabled " + str_index).c_str(), &_enabled);
-    if(ImGui::InputInt(("port " + str_index).c_str(), &_port, 1, 100)) initOsc();
-    if(ImGui::SliderFloat3(("pos " + str_index).c_str(), _pos.getPtr(), -5, 5)) updateMatrix();
-    if(ImGui::SliderFloat3(("rot " + str_index).c_str(), _rot.getPtr(), -180, 180)) updateMatrix();
 
+void Receiver::setParams(const Params& params) {
+    _enabled = params.enabled;
+    if(params.pos != _pos || params.rot != _rot) {
+        _pos = params.pos;
+        _rot = params.rot;
+        updateMatrix();
+    }
+    if(params.port != _port) {
+        _port = params.port;
+        initOsc();
+    }
+}
+
+
+#ifndef PR_HEADLESS
+string Receiver::getStatus(uint64_t now_micros) {
+    StreamHealth::Summary s = health.getSummary(now_micros);
     stringstream str;
-    str << "Connected: " << (_isConnected ? "YES" : "NO") << endl;
-    str << "Num People: " << _numPeople;
-    ImGui::Text(str.str().c_str());
+    str << "Stream: " << StreamHealth::statusName(s.status);
+    if(s.since_last >= 0) str << ", last frame " << ofToString(s.since_last * 1000, 0) << "ms ago";
+    str << endl;
+    str << "Last " << StreamHealth::kWindowSeconds << "s: " << ofToString(s.frame_rate, 1) << " frames/s, " << ofToString(s.packet_rate, 1) << " packets/s, " << ofToString(s.bytes_rate / 1024, 1) << "KB/s" << endl;
+    str << "  lost " << s.lost << " (" << ofToString(s.loss * 100, 1) << "%), reordered " << s.reordered << ", duplicates " << s.duplicates << ", malformed " << ofToString(s.malformed_rate, 1) << "/s" << endl;
+    str << "  arrival jitter " << ofToString(s.jitter, 1) << "ms mean, " << ofToString(s.jitter_max, 1) << "ms max" << endl;
+    str << "Num People: " << _numPeople << endl;
+    str << "Frames: " << health.num_frames << " (last id " << health.last_frame_id << "), lost " << health.num_lost << ", reordered " << health.num_reordered << ", incomplete bodies: " << _numIncomplete << endl;
+    str << "Buffered: " << buffer.size() << ", interval " << ofToString(buffer.getInterval() / 1000, 1) << "ms, jitter " << ofToString(buffer.getJitter() / 1000, 1) << "ms, delay " << ofToString(getDelay() / 1000.0f, 1) << "ms" << endl;
+    str << "Malformed: " << health.num_malformed << endl;
+    str << "Dropped (queue full): " << queue.num_dropped << endl;
+    str << "Shed: " << _numShedPackets << " packets, " << _numShedMessages << " messages";
+    return str.str();
 }
 
+
+bool Receiver::drawGui(int index, Params& params, const string& status) {
+    string str_index = ofToString(index);
+    bool changed = false;
+    ImGui::CollapsingHeader(("Receiver " + str_index).c_str(), NULL, true, true);
+    changed |= ImGui::Checkbox(("Enabled " + str_index).c_str(), &params.enabled);
+    changed |= ImGui::InputInt(("port " + str_index).c_str(), &params.port, 1, 100);
+    changed |= ImGui::SliderFloat3(("pos " + str_index).c_str(), params.pos.getPtr(), -5, 5);
+    changed |= ImGui::SliderFloat3(("rot " + str_index).c_str(), params.rot.getPtr(), -180, 180);
+    ImGui::Text(status.c_str());
+    return changed;
+}
+#endif
+
 void Receiver::updateMatrix() {
     node.setPosition(_pos);
     node.setOrientation(_rot);  // order should be ok, but needs checking
@@ -236,6 +450,12 @@ void Receiver::loadFromXml(ofXml& xml) {
 	spring_strength = xml.getFloatValue("spring_strength");
 	spring_damping = xml.getFloatValue("spring_damping");
 	kill_frame_count = xml.getIntValue("kill_frame_count");
+	if (xml.exists("jitter_buffer")) {
+		jitter_buffer = xml.getBoolValue("jitter_buffer");
+		jitter_mult = xml.getFloatValue("jitter_mult");
+		jitter_min_delay = xml.getFloatValue("jitter_min_delay");
+		jitter_max_delay = xml.getFloatValue("jitter_max_delay");
+	}
 
 
 	xml.setTo("receiver[" + ofToString(_index - 1) + "]");
@@ -1,14 +1,21 @@
 /*
 
  Receives and manages data coming from a single tracker
+ - assemble each tracker frame (bundle) and apply it in one go
+ - buffer frames, so all trackers can be sampled at the same time (see JitterBuffer.h)
  - transform into global space
 
  */
 
 #pragma once
 
-#include "ofxOscReceiver.h"
+#include "osc/OscReceivedElements.h"
 #include "Person.h"
+#include "NetworkThread.h"
+#include "OscRouter.h"
+#include "JitterBuffer.h"
+#include "StreamHealth.h"
+#include "Telemetry.h"
 
 namespace pr {
 
@@ -16,23 +23,60 @@ class Receiver {
 public:
     typedef shared_ptr<Receiver> Ptr;
 
-    static float pos_smoothing;
+    static float pos_smoothing;     // per receiver, and again on the fused persons (see Associator::fuse)
     static float vel_smoothing;
     static float spring_strength;
     static float spring_damping;
     static int kill_frame_count;
+    static bool jitter_buffer;      // sample at a common time behind now, instead of applying frames as they arrive
+    static float jitter_mult;       // delay is frame interval + jitter_mult * jitter
+    static float jitter_min_delay;  // (ms)
+    static float jitter_max_delay;  // (ms)
 	ofQuaternion floorQuat;
 
 
-	Receiver(int i) { _index = i; _port = 8000 + _index; }
+    // max number of persons tracked per receiver (Kinect v2 tracks up to 6 bodies)
+    static const int kMaxPersons = 8;
 
-    // pass in global (i.e. containing all persons from all receivers) vector to update
-    void update(vector<Person::Ptr>& persons_global);
+    // number of datagrams that can be waiting to be parsed (power of two)
+    static const int kQueueSize = 32;
 
-    void drawGui();
+	Receiver(int i, NetworkThread& network) : pool(kMaxPersons), network(network), queue(kQueueSize) { _index = i; _port = 8000 + _index; persons.reserve(kMaxPersons); }
+	~Receiver() { network.remove(&queue); }
+
+    // parse, transform and smooth, advancing dt seconds. persons are sampled as they were at target_micros
+    // (ofGetElapsedTimeMicros() clock), see getDelay(). receivers don't share anything here, so they can update in parallel
+    void update(int64_t target_micros, float dt);
+
+    // add current persons to global (i.e. containing all persons from all receivers) vector
+    void appendPersons(vector<Person::Ptr>& persons_global) const;
+
+    // how far behind now this receiver wants to be sampled (micros). 0 if the jitter buffer is off
+    int64_t getDelay() const;
+
+    // forget everything received so far (waiting datagrams, buffered frames, persons, stream health),
+    // e.g. when the input switches between the sockets and a replay
+    void resetStream();
+
+    // what the gui edits (see Pipeline::drawGui)
+    struct Params {
+        bool enabled;
+        int port;
+        ofVec3f pos;
+        ofVec3f rot;
+    };
+    Params getParams() const;
+    void setParams(const Params& params);   // reopens the port / moves the sensor only if they changed
+
+#ifndef PR_HEADLESS
+    // stream health etc. as text. now_micros: the pipeline's clock
+    string getStatus(uint64_t now_micros);
+
+    // doesn't touch any receiver, so it can run while the pipeline ticks. true if params changed
+    static bool drawGui(int index, Params& params, const string& status);
+#endif
 
     bool isEnabled() const      { return _enabled; }
-    bool isConnected() const    { return _isConnected; }
     int numPeople() const       { return _numPeople; }
 
     void saveToXml(ofXml& xml) const;
@@ -40,26 +84,52 @@ public:
     
     const ofNode& getNode() const   { return node; }
 
+    // color persons from this receiver are drawn in
+    void setColor(const ofColor& c) { _color = c; }
+
 protected:
     bool _enabled = true;
     int _index;         // 1, 2, 3 etc. (starting at 1, not 0)
     int _port = 0;      // port to listen on
     ofVec3f _pos;       // world position of sensor
     ofVec3f _rot;       // world orientation (degrees) of sensor
+    ofColor _color = ofColor::red;
 
-    bool _isConnected;  // is receiving any signal from Tracker
     int _numPeople;      // current number of people on that Tracker
 
     ofNode node;        // contains transformation matrix of kinect (for transformming joints)
 
-    map<int, Person::Ptr> persons; // all current Persons, using a map<int> instead of vector, because the id's aren't nessecary sequential.
+    PersonPool pool;                // storage for all persons of this receiver, preallocated
+    vector<Person::Ptr> persons;    // all current Persons (from pool). few enough to search linearly by user_id
+
+    // receives osc. the network thread fills queue with datagrams, which are parsed in place
+    NetworkThread& network;
+    PacketQueue queue;
+    bool _isListening = false;
+    float _lastListenTime = -1;
+    int _numMessagesParsed = 0;     // this update
+    int _numShedPackets = 0;        // backlogged datagrams that were skipped because a newer one was waiting
+    int _numShedMessages = 0;       // skeleton / floor messages skipped in those
 
-    // receives osc
-    unique_ptr<ofxOscReceiver> oscReceiver;
+    // frames as received, and the frame sampled from them for this update
+    JitterBuffer buffer;
+    SensorFrame* frame = NULL;      // being assembled from the datagram currently parsed, in buffer
+    SensorFrame sampled;
+
+    // rates, loss, jitter etc. of what arrives
+    StreamHealth health;
+    int _numIncomplete = 0;         // bodies that came with some joints missing (the missing ones keep their last value)
 
     void initOsc();
     void parseOsc();
+    void parseBundle(const osc::ReceivedBundle& bundle, bool events_only);
+    void parseMessage(const osc::ReceivedMessage& m, bool events_only);
+    void commitFrame(const SensorFrame& frame);
     void updateMatrix();
+
+    Person::Ptr findPerson(int user_id) const;
+    void removePerson(int user_id);
+    void removeAllPersons();
 };
 
 }
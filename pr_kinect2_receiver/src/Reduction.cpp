@@ -0,0 +1,309 @@
+
+#include "Reduction.h"
+
+#ifndef PR_HEADLESS
+#include "ofxImGui.h"
+#endif
+
+namespace pr {
+
+const char* const Reduction::kTypeNames[Reduction::kNumTypes] = { "centroid", "nearest", "leftmost", "rightmost", "most_active", "zone_average" };
+
+
+Reducer::Reducer() {
+    // what used to be hardwired: average, leftmost, rightmost
+    vector<Reduction> r(3);
+    r[0].type = Reduction::kCentroid;
+    r[1].type = Reduction::kLeftmost;
+    r[2].type = Reduction::kRightmost;
+    setReductions(r);
+}
+
+
+void Reducer::setReductions(const vector<Reduction>& r) {
+    reductions = r;
+    states.resize(reductions.size());
+
+    int n = 0;
+    for(auto&& reduction : reductions) n += reduction.numSlots();
+    if(n > kMaxSlots) ofLogWarning() << "Reducer::setReductions " << n << " slots, only the first " << kMaxSlots << " are output";
+}
+
+
+int Reducer::numSlots() const {
+    int n = 0;
+    for(auto&& reduction : reductions) n += reduction.numSlots();
+    return min(n, kMaxSlots);
+}
+
+
+void Reducer::reduce(const vector<Person::Ptr>& persons, vector<Person::Ptr>& slots) {
+    slots.clear();
+    slot_keys.clear();
+
+    // if no one exists, don't send any person data
+    if(persons.empty()) return;
+
+    for(int r=0; r<reductions.size(); r++) begin(reductions[r], states[r]);
+
+    // one pass over the persons, every reduction looks at each
+    for(auto person : persons) {
+        if(!person) continue;
+        for(int r=0; r<reductions.size(); r++) add(reductions[r], states[r], person);
+    }
+
+    for(int r=0; r<reductions.size(); r++) end(reductions[r], states[r], slots);
+    if(slots.size() > kMaxSlots) slots.resize(kMaxSlots);
+    if(slot_keys.size() > kMaxSlots) slot_keys.resize(kMaxSlots);
+}
+
+
+void Reducer::begin(const Reduction& reduction, State& state) {
+    state.best = std::numeric_limits<float>::max();
+    state.person = NULL;
+    state.num_ranked = 0;
+    state.num_averaged = 0;
+    state.members = 0;
+
+    if(reduction.type == Reduction::kCentroid || reduction.type == Reduction::kZoneAverage) {
+        state.average.joints = Joints();
+        for(int j=0; j<kNumJoints; j++) state.quat_sum[j].set(0, 0, 0, 0);
+    }
+}
+
+
+// lower is further left for kLeftmost, further right for kRightmost
+static float rankKey(const Reduction& reduction, Person::Ptr person) {
+    float x = person->joints.pos[kJointWaist].x;
+    return reduction.type == Reduction::kLeftmost ? x : -x;
+}
+
+
+void Reducer::add(const Reduction& reduction, State& state, Person::Ptr person) {
+    const Joints& joints = person->joints;
+    const ofVec3f& waist = joints.pos[kJointWaist];
+
+    switch(reduction.type) {
+        case Reduction::kNearest: {
+            float d = waist.squareDistance(reduction.point);
+            if(d < state.best) {
+                state.best = d;
+                state.person = person;
+            }
+            break;
+        }
+
+        case Reduction::kMostActive: {
+            float activity = 0;
+            for(int j=0; j<kNumJoints; j++) activity += joints.speed[j];
+            if(-activity < state.best) {
+                state.best = -activity;
+                state.person = person;
+            }
+            break;
+        }
+
+        case Reduction::kLeftmost:
+        case Reduction::kRightmost: {
+            // insert into the few best so far
+            float key = rankKey(reduction, person);
+            int n = reduction.numSlots();
+            int i = state.num_ranked;
+            while(i > 0 && key < rankKey(reduction, state.ranked[i - 1])) i--;
+            if(i >= n) break;
+            int last = min(state.num_ranked, n - 1);
+            for(int k=last; k>i; k--) state.ranked[k] = state.ranked[k - 1];
+            state.ranked[i] = person;
+            state.num_ranked = min(state.num_ranked + 1, n);
+            break;
+        }
+
+        case Reduction::kZoneAverage:
+            if(waist.x < reduction.zone_min.x || waist.y < reduction.zone_min.y || waist.z < reduction.zone_min.z) break;
+            if(waist.x > reduction.zone_max.x || waist.y > reduction.zone_max.y || waist.z > reduction.zone_max.z) break;
+            // fall through, inside the zone
+
+        case Reduction::kCentroid: {
+            Joints& sum = state.average.joints;
+            for(int j=0; j<kNumJoints; j++) {
+                sum.confidence[j]   += joints.confidence[j];
+                sum.pos[j]          += joints.pos[j];
+                sum.pos_target[j]   += joints.pos_target[j];
+                sum.vel[j]          += joints.vel[j];
+                sum.vel_target[j]   += joints.vel_target[j];
+                sum.speed[j]        += joints.speed[j];
+                sum.vec[j]          += joints.vec[j];
+                sum.springy_pos[j]  += joints.springy_pos[j];
+                sum.springy_vel[j]  += joints.springy_vel[j];
+                sum.range[j]        += joints.range[j];
+
+                // quaternions q and -q are the same rotation, flip onto the same side before summing
+                ofVec4f q = joints.quat[j].asVec4();
+                if(q.dot(state.quat_sum[j]) < 0) q = -q;
+                state.quat_sum[j] += q;
+            }
+            state.num_averaged++;
+            state.members += uint32_t(person->global_id) * 2654435761u;   // doesn't depend on the order they come in
+            break;
+        }
+
+        default: break;
+    }
+}
+
+
+// global_id of whoever is in a slot, -1 if no one
+static uint32_t personKey(Person::Ptr person) {
+    return person ? uint32_t(person->global_id) : uint32_t(-1);
+}
+
+
+void Reducer::end(const Reduction& reduction, State& state, vector<Person::Ptr>& slots) {
+    switch(reduction.type) {
+        case Reduction::kNearest:
+        case Reduction::kMostActive:
+            slots.push_back(state.person);
+            slot_keys.push_back(personKey(state.person));
+            break;
+
+        case Reduction::kLeftmost:
+        case Reduction::kRightmost:
+            for(int i=0; i<reduction.numSlots(); i++) {
+                Person::Ptr person = i < state.num_ranked ? state.ranked[i] : NULL;
+                slots.push_back(person);
+                slot_keys.push_back(personKey(person));
+            }
+            break;
+
+        case Reduction::kCentroid:
+        case Reduction::kZoneAverage: {
+            if(state.num_averaged == 0) {
+                slots.push_back(NULL);
+                slot_keys.push_back(personKey(NULL));
+                break;
+            }
+            Joints& joints = state.average.joints;
+            float s = 1.0f / state.num_averaged;
+            for(int j=0; j<kNumJoints; j++) {
+                joints.confidence[j]    *= s;
+                joints.pos[j]           *= s;
+                joints.pos_target[j]    *= s;
+                joints.vel[j]           *= s;
+                joints.vel_target[j]    *= s;
+                joints.speed[j]         *= s;
+                joints.vec[j]           *= s;
+                joints.springy_pos[j]   *= s;
+                joints.springy_vel[j]   *= s;
+                joints.range[j]         *= s;
+                float len = state.quat_sum[j].length();
+                if(len > 0) joints.quat[j] = ofQuaternion(state.quat_sum[j] / len);
+                joints.euler[j] = joints.quat[j].getEuler();
+            }
+            slots.push_back(&state.average);
+            slot_keys.push_back(state.members ^ state.num_averaged);
+            break;
+        }
+
+        default: break;
+    }
+}
+
+
+void Reducer::loadFromXml(ofXml& xml) {
+    if(!xml.exists("//Settings/Reductions")) return;
+    xml.setTo("//Settings/Reductions");
+    int count = xml.getNumChildren("reduction");
+
+    vector<Reduction> r;
+    for(int i=0; i<count; i++) {
+        xml.setTo("//Settings/Reductions/reduction[" + ofToString(i) + "]");
+        Reduction reduction;
+        string type = xml.getValue<string>("type");
+        int t = 0;
+        while(t < Reduction::kNumTypes && type != Reduction::kTypeNames[t]) t++;
+        if(t == Reduction::kNumTypes) {
+            ofLogError() << "Reducer::loadFromXml unknown reduction " << type;
+            continue;
+        }
+        reduction.type = (Reduction::Type)t;
+        if(xml.exists("count")) reduction.count = xml.getIntValue("count");
+        if(xml.exists("point")) reduction.point = ofVec3f(xml.getFloatValue("point/x"), xml.getFloatValue("point/y"), xml.getFloatValue("point/z"));
+        if(xml.exists("zone_min")) reduction.zone_min = ofVec3f(xml.getFloatValue("zone_min/x"), xml.getFloatValue("zone_min/y"), xml.getFloatValue("zone_min/z"));
+        if(xml.exists("zone_max")) reduction.zone_max = ofVec3f(xml.getFloatValue("zone_max/x"), xml.getFloatValue("zone_max/y"), xml.getFloatValue("zone_max/z"));
+        r.push_back(reduction);
+    }
+    setReductions(r);
+}
+
+
+static void addVec3(ofXml& xml, const string& name, const ofVec3f& v) {
+	xml.addChild(name);
+	xml.setTo(name);
+	xml.addValue("x", ofToString(v.x));
+	xml.addValue("y", ofToString(v.y));
+	xml.addValue("z", ofToString(v.z));
+	xml.setToParent();
+}
+
+
+void Reducer::saveToXml(ofXml& xml) const {
+	xml.setTo("//Settings");
+	xml.addChild("Reductions");
+	for (int i=0; i<reductions.size(); i++) {
+		const Reduction& reduction = reductions[i];
+		xml.setTo("//Settings/Reductions");
+		xml.addChild("reduction");
+		xml.setTo("reduction[" + ofToString(i) + "]");
+		xml.addValue("type", Reduction::kTypeNames[reduction.type]);
+		switch (reduction.type) {
+			case Reduction::kLeftmost:
+			case Reduction::kRightmost: xml.addValue("count", ofToString(reduction.count)); break;
+			case Reduction::kNearest: addVec3(xml, "point", reduction.point); break;
+			case Reduction::kZoneAverage: addVec3(xml, "zone_min", reduction.zone_min); addVec3(xml, "zone_max", reduction.zone_max); break;
+			default: break;
+		}
+	}
+}
+
+
+#ifndef PR_HEADLESS
+bool Reducer::drawGui(vector<Reduction>& reductions) {
+    ImGui::CollapsingHeader("Reductions", NULL, true, true);
+
+    bool changed = false;
+    int slot = 0;
+    for(int i=0; i<reductions.size(); i++) {
+        Reduction& reduction = reductions[i];
+        string suffix = " " + ofToString(i);
+        int type = reduction.type;
+        if(ImGui::Combo(("slot " + ofToString(slot) + suffix).c_str(), &type, Reduction::kTypeNames, Reduction::kNumTypes)) {
+            reduction.type = (Reduction::Type)type;
+            changed = true;
+        }
+        switch(reduction.type) {
+            case Reduction::kLeftmost:
+            case Reduction::kRightmost: changed |= ImGui::SliderInt(("count" + suffix).c_str(), &reduction.count, 1, Reduction::kMaxCount); break;
+            case Reduction::kNearest: changed |= ImGui::SliderFloat3(("point" + suffix).c_str(), reduction.point.getPtr(), -5, 5); break;
+            case Reduction::kZoneAverage:
+                changed |= ImGui::SliderFloat3(("zone min" + suffix).c_str(), reduction.zone_min.getPtr(), -10, 10);
+                changed |= ImGui::SliderFloat3(("zone max" + suffix).c_str(), reduction.zone_max.getPtr(), -10, 10);
+                break;
+            default: break;
+        }
+        slot += reduction.numSlots();
+    }
+
+    if(ImGui::Button("add reduction")) {
+        reductions.push_back(Reduction());
+        changed = true;
+    }
+    ImGui::SameLine();
+    if(ImGui::Button("remove reduction") && !reductions.empty()) {
+        reductions.pop_back();
+        changed = true;
+    }
+    return changed;
+}
+#endif
+
+}
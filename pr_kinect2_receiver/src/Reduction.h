@@ -0,0 +1,86 @@
+/*
+ Boils the fused persons down to the output slots, as configured in <Reductions> in settings
+ - each reduction fills its own slot(s), in the order they're listed: a fixed slot layout, whoever is around
+ - all of them are worked out in a single pass over the persons
+ - a slot is NULL when its reduction has no one (e.g. nobody in the zone), the output is empty when there's no one at all
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "Person.h"
+
+namespace pr {
+
+struct Reduction {
+    enum Type {
+        kCentroid,      // average of everyone
+        kNearest,       // closest (waist) to point
+        kLeftmost,      // the count leftmost, leftmost first
+        kRightmost,     // the count rightmost, rightmost first
+        kMostActive,    // highest total joint speed
+        kZoneAverage,   // average of everyone with their waist inside zone_min..zone_max
+        kNumTypes
+    };
+
+    static const char* const kTypeNames[kNumTypes];
+    static const int kMaxCount = 8;
+
+    Type type = kCentroid;
+    int count = 1;                      // kLeftmost / kRightmost
+    ofVec3f point;                      // kNearest
+    ofVec3f zone_min = { -1, -10, -5 }; // kZoneAverage
+    ofVec3f zone_max = { 1, 10, -3 };
+
+    int numSlots() const    { return type == kLeftmost || type == kRightmost ? ofClamp(count, 1, kMaxCount) : 1; }
+};
+
+
+class Reducer {
+public:
+    static const int kMaxSlots = 16;    // as many as the osc has addresses for (OscEncoder::kMaxPersons)
+
+    Reducer();
+
+    // persons in, slots out (pointing into persons, or at averages owned by the reducer)
+    void reduce(const vector<Person::Ptr>& persons, vector<Person::Ptr>& slots);
+
+    int numSlots() const;
+
+    // who's in each slot of the last reduce(): the person's global_id, or for an average a key made from everyone
+    // in it. an average keeps its global_id while people come and go, this changes with them
+    const vector<uint32_t>& getSlotKeys() const  { return slot_keys; }
+
+    const vector<Reduction>& getReductions() const  { return reductions; }
+    void setReductions(const vector<Reduction>& r);
+
+    void loadFromXml(ofXml& xml);
+    void saveToXml(ofXml& xml) const;
+#ifndef PR_HEADLESS
+    // edits a copy of the reductions, no reducer needed. true if it changed
+    static bool drawGui(vector<Reduction>& reductions);
+#endif
+
+protected:
+    // running state of one reduction during the pass
+    struct State {
+        float best;
+        Person::Ptr person;                     // kNearest, kMostActive
+        Person::Ptr ranked[Reduction::kMaxCount];   // kLeftmost, kRightmost, best first
+        int num_ranked;
+        int num_averaged;                       // kCentroid, kZoneAverage
+        uint32_t members;                       // key of who's been averaged
+        ofVec4f quat_sum[kNumJoints];
+        Person average;
+    };
+
+    vector<Reduction> reductions;
+    vector<State> states;
+    vector<uint32_t> slot_keys;
+
+    void begin(const Reduction& reduction, State& state);
+    void add(const Reduction& reduction, State& state, Person::Ptr person);
+    void end(const Reduction& reduction, State& state, vector<Person::Ptr>& slots);
+};
+
+}
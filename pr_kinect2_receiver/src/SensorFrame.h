@@ -0,0 +1,59 @@
+/*
+ Everything one tracker sent for one of its frames (one OSC bundle), still in sensor space.
+ The Receiver fills one of these while parsing a bundle and only applies it to its persons once
+ the whole bundle has been read, so persons never hold half of one frame and half of another.
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "Joints.h"
+
+namespace pr {
+
+struct SensorFrame {
+    static const int kMaxBodies = 8;
+
+    struct Body {
+        int user_id;
+        uint32_t joint_mask;                // bit j set if joint j was received
+        float confidence[kNumJoints];
+        ofVec3f pos[kNumJoints];
+        ofQuaternion quat[kNumJoints];
+        ofVec3f vel[kNumJoints];
+
+        bool isComplete() const { return joint_mask == kAllJoints; }
+    };
+
+    int frame_id = -1;                      // from /frame, -1 if the tracker didn't send one
+    int64_t capture_micros = 0;             // from /frame, tracker's clock. 0 if not sent
+    uint64_t arrival_micros = 0;            // our clock, when the datagram arrived
+
+    bool has_floor = false;
+    ofVec4f floor;                          // /floorplane
+
+    int num_bodies = 0;
+    Body bodies[kMaxBodies];
+
+    void clear() {
+        frame_id = -1;
+        capture_micros = 0;
+        arrival_micros = 0;
+        has_floor = false;
+        num_bodies = 0;
+    }
+
+    bool isEmpty() const { return num_bodies == 0 && !has_floor; }
+
+    // body for user_id, added if it's not in this frame yet. NULL if the frame is full
+    Body* getBody(int user_id) {
+        for(int i=0; i<num_bodies; i++) if(bodies[i].user_id == user_id) return &bodies[i];
+        if(num_bodies == kMaxBodies) return NULL;
+        Body& body = bodies[num_bodies++];
+        body.user_id = user_id;
+        body.joint_mask = 0;
+        return &body;
+    }
+};
+
+}
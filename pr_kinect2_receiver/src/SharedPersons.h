@@ -0,0 +1,184 @@
+/*
+ Layout of the shared memory the receiver publishes the fused persons into (see SharedSender.h),
+ and everything a consumer on the same machine needs to read it. no oF, just copy this file into the consumer.
+ - the region holds kNumSlots frames. the writer fills the slot after the newest one, with that slot's seq odd while it's writing, then bumps newest
+ - a reader looks at the newest slot in place and afterwards checks its seq didn't change (a seqlock). no copies, no syscalls, never blocks the writer
+ - a read only fails if the writer gets all the way round the slots while it's reading
+
+ usage:
+    pr::shm::Reader reader;
+    reader.open();      // once (and again if it fails, e.g. the receiver isn't running yet)
+    ...
+    bool ok = reader.read([&](const pr::shm::Frame& frame) {
+        // the frame may be torn, never index with anything from it unchecked
+        int n = std::min<int>(frame.num_persons, pr::shm::kMaxPersons);
+        for(int i=0; i<n; i++) drawPerson(frame.persons[i]);
+    });
+    // if !ok, frame was overwritten while we were reading it, ignore anything we got from it
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace pr {
+namespace shm {
+
+static const char* const kDefaultName = "pr_kinect2_persons";
+
+static const uint32_t kMagic = 0x50524b32;     // 'PRK2'
+static const uint32_t kVersion = 1;
+
+static const int kNumJoints = 25;   // same order as kJointNames in Joints.h
+static const int kMaxPersons = 16;
+static const int kNumSlots = 4;
+
+// everything in world space, same as the osc
+struct Joint {
+    float confidence;       // 0..1
+    float pos[3];
+    float quat[4];          // x, y, z, w
+    float euler[3];
+    float vel[3];
+    float speed;
+    float vec[3];           // vector to parent
+    float springy_pos[3];
+    float springy_vel[3];
+};
+
+struct Person {
+    int32_t id;             // stays the same for as long as the receiver keeps tracking this person
+    int32_t reserved;
+    Joint joints[kNumJoints];
+};
+
+struct Frame {
+    uint64_t frame_num;     // counts up by one every frame the receiver processes
+    uint64_t micros;        // system clock when the frame was written, microseconds since the epoch
+    int32_t num_persons;    // sorted left to right
+    int32_t reserved;
+    Person persons[kMaxPersons];
+};
+
+struct Slot {
+    alignas(64) std::atomic<uint32_t> seq;  // odd while the writer is in here
+    Frame frame;
+};
+
+struct Region {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;                          // sizeof(Region)
+    uint32_t num_slots;
+    alignas(64) std::atomic<uint64_t> newest;   // frames written so far. the newest is in slots[(newest - 1) % kNumSlots]
+    Slot slots[kNumSlots];
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "shm::Region needs lock free atomics to work across processes");
+
+
+// maps the named region into this process
+class Mapping {
+public:
+    ~Mapping()      { close(); }
+
+    // writer: creates the region, or maps the existing one if it's there from a previous run
+    bool create(const std::string& name)    { return map(name, true); }
+
+    // reader
+    bool open(const std::string& name)      { return map(name, false); }
+
+    void close() {
+#ifdef _WIN32
+        if(region) UnmapViewOfFile(region);
+        if(handle) CloseHandle(handle);
+        handle = NULL;
+#else
+        if(region) munmap(region, sizeof(Region));
+#endif
+        region = NULL;
+    }
+
+    Region* get() const { return region; }
+
+private:
+    Region* region = NULL;
+#ifdef _WIN32
+    HANDLE handle = NULL;
+#endif
+
+    bool map(const std::string& name, bool writable) {
+        close();
+#ifdef _WIN32
+        std::string path = "Local\\" + name;
+        if(writable) handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(Region), path.c_str());
+        else handle = OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+        if(!handle) return false;
+        region = (Region*)MapViewOfFile(handle, writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, sizeof(Region));
+#else
+        std::string path = "/" + name;
+        int fd = shm_open(path.c_str(), writable ? O_CREAT | O_RDWR : O_RDONLY, 0666);
+        if(fd < 0) return false;
+        struct stat st;
+        bool ok = writable ? ftruncate(fd, sizeof(Region)) == 0 : fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(Region);
+        void* p = ok ? mmap(NULL, sizeof(Region), writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if(p != MAP_FAILED) region = (Region*)p;
+#endif
+        if(region && !writable && (region->magic != kMagic || region->version != kVersion || region->size != sizeof(Region))) close();
+        return region != NULL;
+    }
+};
+
+
+class Reader {
+public:
+    bool open(const std::string& name = kDefaultName)   { return mapping.open(name); }
+    bool isOpen() const                                 { return mapping.get() != NULL; }
+
+    // calls fn(const Frame&) on the newest frame, in place. returns false if there's none yet,
+    // or if it was overwritten while fn was looking at it (then fn may have seen garbage, so throw away what it got)
+    template<typename F>
+    bool read(F fn) {
+        const Region* region = mapping.get();
+        if(!region) return false;
+        uint64_t newest = region->newest.load(std::memory_order_acquire);
+        if(newest == 0) return false;
+
+        const Slot& slot = region->slots[(newest - 1) % kNumSlots];
+        uint32_t seq = slot.seq.load(std::memory_order_acquire);
+        if(seq & 1) return false;
+        fn(slot.frame);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.seq.load(std::memory_order_relaxed) == seq;
+    }
+
+    // copies the newest frame into out, retrying if it's overwritten while copying
+    bool copy(Frame& out, int tries = 4) {
+        for(int i=0; i<tries; i++) {
+            if(read([&](const Frame& frame) { memcpy(&out, &frame, sizeof(Frame)); })) return true;
+        }
+        return false;
+    }
+
+    // frames written so far, cheap way to check if there's anything new
+    uint64_t numFrames() const  { return mapping.get() ? mapping.get()->newest.load(std::memory_order_acquire) : 0; }
+
+private:
+    Mapping mapping;
+};
+
+}
+}
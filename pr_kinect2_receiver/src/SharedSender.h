@@ -0,0 +1,156 @@
+/*
+ Publishes the fused persons into shared memory every frame, for consumers on the same machine (layout and reader in SharedPersons.h)
+ alternative to OscSender for local consumers, no serializing, no loopback, no parsing
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "Person.h"
+#include "SharedPersons.h"
+
+#ifndef PR_HEADLESS
+#include "ofxImGui.h"
+#endif
+
+
+namespace pr {
+
+static_assert(shm::kNumJoints == kNumJoints, "SharedPersons.h and Joints.h disagree on the joints");
+
+class SharedSender {
+public:
+    bool enabled = false;
+    string name = shm::kDefaultName;
+
+
+    void init() {
+        region = NULL;
+        mapping.close();
+        if(!enabled) return;
+
+        if(!mapping.create(name)) {
+            ofLogError() << "SharedSender::init couldn't create shared memory " << name;
+            return;
+        }
+        region = mapping.get();
+
+        // left over from a previous run with the same layout, carry on from there so readers don't notice the restart.
+        // if that run died in the middle of send(), the slot it was writing has an odd seq, even it up or every seq
+        // of that slot would have the wrong parity from now on. it's the slot after the newest, nobody reads it until it's written again
+        if(region->magic == shm::kMagic && region->version == shm::kVersion && region->size == sizeof(shm::Region)) {
+            for(auto&& slot : region->slots) slot.seq.store((slot.seq.load(std::memory_order_relaxed) + 1) & ~1u, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            return;
+        }
+
+        region->magic = 0;
+        region->version = shm::kVersion;
+        region->size = sizeof(shm::Region);
+        region->num_slots = shm::kNumSlots;
+        region->newest.store(0, std::memory_order_relaxed);
+        for(auto&& slot : region->slots) slot.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        region->magic = shm::kMagic;
+    }
+
+
+    // persons sorted left to right. any more than shm::kMaxPersons are left out
+    void send(const vector<Person::Ptr>& persons) {
+        if(!enabled || !region) return;
+
+        uint64_t newest = region->newest.load(std::memory_order_relaxed);
+        shm::Slot& slot = region->slots[newest % shm::kNumSlots];
+        uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+
+        slot.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        shm::Frame& frame = slot.frame;
+        frame.frame_num = newest;
+        frame.micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        frame.num_persons = min<int>(persons.size(), shm::kMaxPersons);
+        for(int i=0; i<frame.num_persons; i++) write(*persons[i], frame.persons[i]);
+
+        slot.seq.store(seq + 2, std::memory_order_release);
+        region->newest.store(newest + 1, std::memory_order_release);
+    }
+
+
+    // opens / closes the shared memory if it changed (see Pipeline::drawGui)
+    void setEnabled(bool e) {
+        if(e == enabled) return;
+        enabled = e;
+        init();
+    }
+
+
+#ifndef PR_HEADLESS
+    string getStatus() const {
+        return "Name: " + name + (region ? "" : " (not open)");
+    }
+
+    // no sender needed. true if enabled changed
+    static bool drawGui(bool& enabled, const string& status) {
+        ImGui::CollapsingHeader("SharedSender", NULL, true, true);
+        bool changed = ImGui::Checkbox("Shared memory enabled", &enabled);
+        ImGui::Text(status.c_str());
+        return changed;
+    }
+#endif
+
+
+    void loadFromXml(ofXml& xml) {
+        if(!xml.exists("//Settings/SharedMemory")) return;
+		xml.setTo("//Settings/SharedMemory");
+		bool new_enabled = xml.getBoolValue("enabled");
+		string new_name = xml.getValue<string>("name");
+		if(new_name.empty()) new_name = shm::kDefaultName;
+		if(new_enabled != enabled || new_name != name || (enabled && !region)) {
+			enabled = new_enabled;
+			name = new_name;
+			init();
+		}
+    }
+
+    void saveToXml(ofXml& xml) {
+		xml.setTo("//Settings");
+		xml.addChild("SharedMemory");
+		xml.setTo("SharedMemory");
+		xml.addValue("enabled", ofToString(enabled));
+		xml.addValue("name", name);
+    }
+
+
+private:
+    shm::Mapping mapping;
+    shm::Region* region = NULL;
+
+    static void write(const Person& person, shm::Person& out) {
+        const Joints& joints = person.joints;
+        out.id = person.global_id;
+        for(int j=0; j<kNumJoints; j++) {
+            shm::Joint& joint = out.joints[j];
+            joint.confidence = joints.confidence[j];
+            copy3(joints.pos[j], joint.pos);
+            joint.quat[0] = joints.quat[j]._v.x;
+            joint.quat[1] = joints.quat[j]._v.y;
+            joint.quat[2] = joints.quat[j]._v.z;
+            joint.quat[3] = joints.quat[j]._v.w;
+            copy3(joints.euler[j], joint.euler);
+            copy3(joints.vel[j], joint.vel);
+            joint.speed = joints.speed[j];
+            copy3(joints.vec[j], joint.vec);
+            copy3(joints.springy_pos[j], joint.springy_pos);
+            copy3(joints.springy_vel[j], joint.springy_vel);
+        }
+    }
+
+    static void copy3(const ofVec3f& v, float* out) {
+        out[0] = v.x;
+        out[1] = v.y;
+        out[2] = v.z;
+    }
+};
+
+}
@@ -0,0 +1,226 @@
+/*
+ How well one tracker's stream is arriving, over the last kWindowSeconds (a ring of one second buckets, nothing allocated)
+ - packets, frames, bytes and malformed messages per second
+ - inter-arrival jitter: how far each frame arrived from when it should have, given the one before
+   (capture times from /frame if the tracker sends them, else the expected frame interval)
+ - loss and reordering from /frame ids. without them: reordering from the bundle timetags (if the tracker sets them),
+   loss from gaps in arrival of more than 1.5 frame intervals (gaps over kMaxGap are taken as the tracker pausing, not loss)
+ - time since the last frame
+ only touched from Receiver::update() and getStatus(), both on the pipeline's thread
+ */
+
+#pragma once
+
+#include "ofMain.h"
+
+namespace pr {
+
+class StreamHealth {
+public:
+    static const int kWindowSeconds = 10;
+    static const int64_t kMaxGap = 1000000;         // (micros)
+    static const int kMaxIdJump = 1000;             // ids jumping further than this (either way) mean the tracker restarted
+
+    enum Status {
+        kStatusNoSignal,    // nothing for over a second
+        kStatusStalled,     // nothing for a few frames
+        kStatusDegraded,    // losing, reordering or mangling frames
+        kStatusOk
+    };
+
+    // over the window
+    struct Summary {
+        float packet_rate = 0;      // per second
+        float frame_rate = 0;
+        float bytes_rate = 0;
+        float malformed_rate = 0;
+        float loss = 0;             // fraction of the frames sent that never arrived
+        int lost = 0;
+        int reordered = 0;          // arrived after a later frame
+        int duplicates = 0;
+        float jitter = 0;           // mean (ms)
+        float jitter_max = 0;       // (ms)
+        float since_last = -1;      // seconds since the last frame, -1 if there never was one
+        Status status = kStatusNoSignal;
+    };
+
+    // totals
+    uint64_t num_packets = 0;
+    uint64_t num_frames = 0;
+    uint64_t num_lost = 0;
+    uint64_t num_reordered = 0;
+    uint64_t num_malformed = 0;
+    int last_frame_id = -1;         // -1 if the tracker doesn't send them
+
+    StreamHealth() { clear(); }
+
+    void clear() {
+        memset(buckets, 0, sizeof(buckets));
+        current_second = -1;
+        first_micros = 0;
+        last_arrival = 0;
+        last_capture = 0;
+        last_timetag = 0;
+        last_frame_id = -1;
+    }
+
+    // every datagram, as it's parsed
+    void onPacket(uint64_t arrival_micros, int size) {
+        Bucket& bucket = advance(arrival_micros);
+        bucket.packets++;
+        bucket.bytes += size;
+        num_packets++;
+    }
+
+    // every datagram that carried a tracker frame. frame_id and capture_micros as in SensorFrame, timetag of its bundle (0 if none),
+    // interval: expected frame interval (micros)
+    void onFrame(uint64_t arrival_micros, int frame_id, int64_t capture_micros, uint64_t timetag, float interval) {
+        Bucket& bucket = advance(arrival_micros);
+        bucket.frames++;
+        num_frames++;
+
+        bool in_order = true;
+        int lost = 0;
+        if(frame_id >= 0) {
+            int expected = last_frame_id + 1;
+            if(last_frame_id < 0 || abs(frame_id - expected) > kMaxIdJump) {
+                // first one, or the tracker restarted
+            } else if(frame_id > expected) {
+                lost = frame_id - expected;
+            } else if(frame_id == last_frame_id) {
+                bucket.duplicates++;
+                in_order = false;
+            } else if(frame_id < expected) {
+                // counted as lost when the ones after it came, it wasn't
+                bucket.lost--;
+                if(num_lost) num_lost--;
+                bucket.reordered++;
+                num_reordered++;
+                in_order = false;
+            }
+            if(in_order) last_frame_id = frame_id;
+        } else {
+            // no ids. timetag 1 means "immediately", i.e. not set
+            if(timetag > 1) {
+                if(timetag < last_timetag) {
+                    bucket.reordered++;
+                    num_reordered++;
+                    in_order = false;
+                } else {
+                    last_timetag = timetag;
+                }
+            }
+            if(in_order && last_arrival && interval > 0) {
+                int64_t gap = arrival_micros - last_arrival;
+                if(gap > 1.5f * interval && gap < kMaxGap) lost = roundf(gap / interval) - 1;
+            }
+        }
+        bucket.lost += lost;
+        num_lost += lost;
+
+        // only against the newest frame so far, a late one is already counted as reordered
+        if(in_order) {
+            if(last_arrival) {
+                int64_t expected_gap = capture_micros && last_capture ? capture_micros - last_capture : interval * (lost + 1);
+                int64_t gap = arrival_micros - last_arrival;
+                if(gap < kMaxGap) {
+                    float deviation = fabs(float(gap - expected_gap)) / 1000.0f;
+                    bucket.jitter_sum += deviation;
+                    bucket.jitter_count++;
+                    bucket.jitter_max = max(bucket.jitter_max, deviation);
+                }
+            }
+            last_arrival = arrival_micros;
+            last_capture = capture_micros;
+        }
+    }
+
+    void onMalformed(uint64_t now_micros) {
+        advance(now_micros).malformed++;
+        num_malformed++;
+    }
+
+    Summary getSummary(uint64_t now_micros) {
+        advance(now_micros);
+
+        Summary summary;
+        if(!first_micros) return summary;
+
+        int packets = 0, frames = 0, malformed = 0, jitter_count = 0;
+        int64_t bytes = 0;
+        float jitter_sum = 0;
+        for(auto&& bucket : buckets) {
+            packets += bucket.packets;
+            frames += bucket.frames;
+            bytes += bucket.bytes;
+            malformed += bucket.malformed;
+            summary.lost += bucket.lost;
+            summary.reordered += bucket.reordered;
+            summary.duplicates += bucket.duplicates;
+            jitter_sum += bucket.jitter_sum;
+            jitter_count += bucket.jitter_count;
+            summary.jitter_max = max(summary.jitter_max, bucket.jitter_max);
+        }
+        summary.lost = max(summary.lost, 0);
+
+        // the current second is only partly over, and the window may not be full yet
+        float seconds = (kWindowSeconds - 1) + (now_micros % 1000000) / 1e6f;
+        seconds = max(min(seconds, (now_micros - first_micros) / 1e6f), 0.001f);
+        summary.packet_rate = packets / seconds;
+        summary.frame_rate = frames / seconds;
+        summary.bytes_rate = bytes / seconds;
+        summary.malformed_rate = malformed / seconds;
+        if(frames + summary.lost > 0) summary.loss = float(summary.lost) / (frames + summary.lost);
+        if(jitter_count) summary.jitter = jitter_sum / jitter_count;
+
+        if(last_arrival) summary.since_last = (now_micros - last_arrival) / 1e6f;
+
+        float frame_interval = frames > 1 ? seconds / frames : 0.1f;
+        if(summary.since_last < 0 || summary.since_last > 1) summary.status = kStatusNoSignal;
+        else if(summary.since_last > 3 * frame_interval) summary.status = kStatusStalled;
+        else if(summary.loss > 0.02f || summary.reordered || malformed) summary.status = kStatusDegraded;
+        else summary.status = kStatusOk;
+        return summary;
+    }
+
+    static const char* statusName(Status status) {
+        static const char* const names[] = { "NO SIGNAL", "STALLED", "DEGRADED", "OK" };
+        return names[status];
+    }
+
+private:
+    struct Bucket {
+        int packets;
+        int frames;
+        int64_t bytes;
+        int malformed;
+        int lost;           // can go below 0 in a bucket, when a frame lost in an earlier one turns up
+        int reordered;
+        int duplicates;
+        float jitter_sum;   // (ms)
+        int jitter_count;
+        float jitter_max;
+    };
+
+    Bucket buckets[kWindowSeconds];
+    int64_t current_second;
+    uint64_t first_micros;
+    uint64_t last_arrival;
+    int64_t last_capture;
+    uint64_t last_timetag;
+
+    // bucket for this time, clearing any seconds skipped since the last one
+    Bucket& advance(uint64_t micros) {
+        if(!first_micros) first_micros = micros;
+        int64_t second = micros / 1000000;
+        if(second > current_second) {
+            if(current_second < 0 || second - current_second >= kWindowSeconds) memset(buckets, 0, sizeof(buckets));
+            else for(int64_t s=current_second + 1; s<=second; s++) memset(&buckets[s % kWindowSeconds], 0, sizeof(Bucket));
+            current_second = second;
+        }
+        // a packet stamped a little before the newest still counts in the current second
+        return buckets[current_second % kWindowSeconds];
+    }
+};
+
+}
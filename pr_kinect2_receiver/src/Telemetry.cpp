@@ -0,0 +1,240 @@
+
+#include "Telemetry.h"
+
+#ifndef PR_HEADLESS
+#include "ofxImGui.h"
+#endif
+
+namespace pr {
+
+static const char* const kStageNames[kNumStages] = { "parse", "transform", "smoothing", "fusion", "reduction", "prediction", "encode", "send", "tick" };
+static const char* const kCounterNames[kNumCounters] = { "datagrams_in", "bytes_in", "messages_in", "datagrams_out", "bytes_out" };
+static const char* const kGaugeNames[kNumGauges] = { "persons", "unique_persons" };
+
+float Telemetry::interval = 5;
+string Telemetry::filename = "stats.prom";
+
+
+Telemetry& Telemetry::get() {
+    static Telemetry telemetry;
+    return telemetry;
+}
+
+
+Telemetry::Telemetry() {
+    for(auto&& histogram : histograms) {
+        for(auto&& bucket : histogram.buckets) bucket = 0;
+        histogram.sum_nanos = 0;
+        histogram.max_nanos = 0;
+    }
+    for(auto&& counter : counters) counter = 0;
+    for(auto&& gauge : gauges) gauge = 0;
+    memset(last_buckets, 0, sizeof(last_buckets));
+    memset(last_sum_nanos, 0, sizeof(last_sum_nanos));
+    memset(last_counters, 0, sizeof(last_counters));
+    memset(summary, 0, sizeof(summary));
+}
+
+
+void Telemetry::addTime(Stage stage, uint64_t nanos) {
+    Histogram& histogram = histograms[stage];
+
+    // index of the highest bit of the micros, +1
+    uint64_t micros = nanos / 1000;
+    int b = 0;
+    while(micros && b < kNumBuckets - 1) {
+        micros >>= 1;
+        b++;
+    }
+
+    histogram.buckets[b].fetch_add(1, std::memory_order_relaxed);
+    histogram.sum_nanos.fetch_add(nanos, std::memory_order_relaxed);
+    uint64_t max = histogram.max_nanos.load(std::memory_order_relaxed);
+    while(nanos > max && !histogram.max_nanos.compare_exchange_weak(max, nanos, std::memory_order_relaxed));
+}
+
+
+bool Telemetry::update(float dt, float* stats) {
+    elapsed += dt;
+    if(interval <= 0 || elapsed < interval) return false;
+
+    float* s = stats;
+    for(int i=0; i<kNumStages; i++) {
+        Histogram& histogram = histograms[i];
+
+        // this window's buckets
+        uint64_t buckets[kNumBuckets];
+        uint64_t count = 0;
+        for(int b=0; b<kNumBuckets; b++) {
+            uint64_t total = histogram.buckets[b].load(std::memory_order_relaxed);
+            buckets[b] = total - last_buckets[i][b];
+            last_buckets[i][b] = total;
+            count += buckets[b];
+        }
+        uint64_t sum_nanos = histogram.sum_nanos.load(std::memory_order_relaxed);
+        uint64_t window_sum = sum_nanos - last_sum_nanos[i];
+        last_sum_nanos[i] = sum_nanos;
+
+        // p99 is the top of the bucket it falls in
+        float p99 = 0;
+        uint64_t seen = 0;
+        for(int b=0; b<kNumBuckets && count; b++) {
+            seen += buckets[b];
+            if(seen * 100 >= count * 99) {
+                p99 = 1u << b;
+                break;
+            }
+        }
+
+        *s++ = count ? window_sum / 1000.0f / count : 0;
+        *s++ = p99;
+        *s++ = histogram.max_nanos.exchange(0, std::memory_order_relaxed) / 1000.0f;
+    }
+
+    for(int i=0; i<kNumCounters; i++) {
+        uint64_t total = counters[i].load(std::memory_order_relaxed);
+        *s++ = (total - last_counters[i]) / elapsed;
+        last_counters[i] = total;
+    }
+
+    for(int i=0; i<kNumGauges; i++) *s++ = gauges[i].load(std::memory_order_relaxed);
+
+    elapsed = 0;
+
+    {
+        std::unique_lock<std::mutex> lock(summary_mutex);
+        memcpy(summary, stats, sizeof(summary));
+    }
+
+    // the last_ arrays are the running totals now, the file is written from a copy of them
+    if(!filename.empty()) {
+        Totals totals;
+        memcpy(totals.buckets, last_buckets, sizeof(totals.buckets));
+        memcpy(totals.sum_nanos, last_sum_nanos, sizeof(totals.sum_nanos));
+        memcpy(totals.counters, last_counters, sizeof(totals.counters));
+        memcpy(totals.gauges, stats + kNumStages * 3 + kNumCounters, sizeof(totals.gauges));
+        file_writer.write(totals, filename);
+    }
+    return true;
+}
+
+
+Telemetry::FileWriter::~FileWriter() {
+    if(!isThreadRunning()) return;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopThread();
+    }
+    condition.notify_all();
+    waitForThread(false);
+}
+
+
+void Telemetry::FileWriter::write(const Totals& totals, const string& filename) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        pending = totals;
+        pending_filename = filename;
+        has_pending = true;
+    }
+    if(isThreadRunning()) condition.notify_all();
+    else startThread();
+}
+
+
+void Telemetry::FileWriter::threadedFunction() {
+    Totals totals;
+    string filename;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(!has_pending && isThreadRunning()) condition.wait(lock);
+            if(!isThreadRunning()) return;
+            totals = pending;
+            filename = pending_filename;
+            has_pending = false;
+        }
+        writeFile(totals, filename);
+    }
+}
+
+
+void Telemetry::writeFile(const Totals& totals, const string& filename) {
+    stringstream str;
+    str << "# TYPE pr_stage_seconds histogram" << endl;
+    for(int i=0; i<kNumStages; i++) {
+        uint64_t cumulative = 0;
+        for(int b=0; b<kNumBuckets - 1; b++) {
+            cumulative += totals.buckets[i][b];
+            str << "pr_stage_seconds_bucket{stage=\"" << kStageNames[i] << "\",le=\"" << (1u << b) / 1e6 << "\"} " << cumulative << endl;
+        }
+        cumulative += totals.buckets[i][kNumBuckets - 1];
+        str << "pr_stage_seconds_bucket{stage=\"" << kStageNames[i] << "\",le=\"+Inf\"} " << cumulative << endl;
+        str << "pr_stage_seconds_sum{stage=\"" << kStageNames[i] << "\"} " << totals.sum_nanos[i] / 1e9 << endl;
+        str << "pr_stage_seconds_count{stage=\"" << kStageNames[i] << "\"} " << cumulative << endl;
+    }
+    for(int i=0; i<kNumCounters; i++) {
+        str << "# TYPE pr_" << kCounterNames[i] << "_total counter" << endl;
+        str << "pr_" << kCounterNames[i] << "_total " << totals.counters[i] << endl;
+    }
+    for(int i=0; i<kNumGauges; i++) {
+        str << "# TYPE pr_" << kGaugeNames[i] << " gauge" << endl;
+        str << "pr_" << kGaugeNames[i] << " " << totals.gauges[i] << endl;
+    }
+
+    // write next to it and rename, so a scraper never sees half a file
+    string path = ofToDataPath(filename, true);
+    string tmp = path + ".tmp";
+    {
+        ofstream file(tmp.c_str(), ios::out | ios::trunc);
+        if(!file) {
+            ofLogError() << "Telemetry::writeFile could not write " << tmp;
+            return;
+        }
+        file << str.str();
+    }
+#ifdef TARGET_WIN32
+    std::remove(path.c_str());      // rename won't replace an existing file
+#endif
+    std::rename(tmp.c_str(), path.c_str());
+}
+
+
+void Telemetry::loadFromXml(ofXml& xml) {
+    if(!xml.exists("//Settings/Telemetry")) return;
+    xml.setTo("//Settings/Telemetry");
+    interval = xml.getFloatValue("interval");
+    filename = xml.exists("file") ? xml.getValue<string>("file") : "";
+}
+
+
+void Telemetry::saveToXml(ofXml& xml) const {
+	xml.setTo("//Settings");
+	xml.addChild("Telemetry");
+	xml.setTo("Telemetry");
+	xml.addValue("interval", ofToString(interval));
+	xml.addValue("file", filename);
+}
+
+
+#ifndef PR_HEADLESS
+void Telemetry::drawGui() {
+    float s[kNumStatsValues];
+    {
+        std::unique_lock<std::mutex> lock(summary_mutex);
+        memcpy(s, summary, sizeof(s));
+    }
+
+    stringstream str;
+    str << "Last " << interval << "s (us: mean / p99 / max)" << endl;
+    for(int i=0; i<kNumStages; i++) {
+        str << "  " << kStageNames[i] << ": " << ofToString(s[i * 3], 1) << " / " << s[i * 3 + 1] << " / " << ofToString(s[i * 3 + 2], 1) << endl;
+    }
+    const float* rates = s + kNumStages * 3;
+    str << "In: " << ofToString(rates[kCounterDatagramsIn], 1) << " datagrams/s, " << ofToString(rates[kCounterMessagesIn], 0) << " messages/s, " << ofToString(rates[kCounterBytesIn] / 1024, 1) << "KB/s" << endl;
+    str << "Out: " << ofToString(rates[kCounterDatagramsOut], 1) << " datagrams/s, " << ofToString(rates[kCounterBytesOut] / 1024, 1) << "KB/s";
+    ImGui::Text(str.str().c_str());
+}
+#endif
+
+}
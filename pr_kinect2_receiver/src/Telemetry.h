@@ -0,0 +1,140 @@
+/*
+ Always on, cheap instrumentation of the processing, so it can run during shows
+ - a ScopedTimer around each stage adds its duration to that stage's histogram (fixed power of 2 buckets),
+   counters count what goes in and out. all relaxed atomics, any thread can add (the receivers run on the pool)
+ - every interval seconds (<Telemetry> in settings) the window since the last one is summarised: for the GUI,
+   for /stats to the outputs that want it, and the running totals go to a Prometheus style text file
+   (written on a thread of its own, the disk never holds up a tick)
+
+ /stats args, all floats: per Stage (in order) mean, p99 and max in micros, then per Counter its rate per second, then per Gauge its value
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include <condition_variable>
+
+namespace pr {
+
+enum Stage {
+    kStageParse,        // osc -> jitter buffer, all receivers
+    kStageTransform,    // sampled frame -> world space persons
+    kStageSmoothing,    // smoothing, springs, vectors
+    kStageFusion,       // association and kalman fusion
+    kStageReduction,    // output slots
+    kStagePrediction,   // moving the slots ahead by the latency
+    kStageEncode,       // osc encoding, all outputs
+    kStageSend,         // sendto() and shared memory
+    kStageTick,         // the whole tick
+    kNumStages
+};
+
+enum Counter {
+    kCounterDatagramsIn,
+    kCounterBytesIn,
+    kCounterMessagesIn,
+    kCounterDatagramsOut,
+    kCounterBytesOut,
+    kNumCounters
+};
+
+enum Gauge {
+    kGaugePersons,          // from all receivers
+    kGaugeUniquePersons,    // after fusion
+    kNumGauges
+};
+
+
+class Telemetry {
+public:
+    static const int kNumBuckets = 20;      // bucket b counts durations under 2^b micros, the last everything longer
+    static const int kNumStatsValues = kNumStages * 3 + kNumCounters + kNumGauges;
+
+    static float interval;                  // seconds between summaries / exports, 0 for never
+    static string filename;                 // Prometheus text file, in data. empty for none
+
+    static Telemetry& get();
+
+    static uint64_t nanos() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+    void addTime(Stage stage, uint64_t nanos);
+    void count(Counter counter, uint64_t n = 1)     { counters[counter].fetch_add(n, std::memory_order_relaxed); }
+    void set(Gauge gauge, float value)              { gauges[gauge].store(value, std::memory_order_relaxed); }
+
+    // call once per tick from the processing thread. returns true when a new summary is ready (and fills stats with the /stats args)
+    bool update(float dt, float* stats);
+
+    void loadFromXml(ofXml& xml);
+    void saveToXml(ofXml& xml) const;
+#ifndef PR_HEADLESS
+    // last summary. any thread
+    void drawGui();
+#endif
+
+private:
+    struct Histogram {
+        atomic<uint64_t> buckets[kNumBuckets];
+        atomic<uint64_t> sum_nanos;
+        atomic<uint64_t> max_nanos;     // this window
+    };
+
+    // running totals, never reset
+    Histogram histograms[kNumStages];
+    atomic<uint64_t> counters[kNumCounters];
+    atomic<float> gauges[kNumGauges];
+
+    // totals at the last summary, to get the window from
+    uint64_t last_buckets[kNumStages][kNumBuckets];
+    uint64_t last_sum_nanos[kNumStages];
+    uint64_t last_counters[kNumCounters];
+    float elapsed = 0;
+
+    // last summary, same layout as /stats
+    std::mutex summary_mutex;
+    float summary[kNumStatsValues];
+
+    // running totals as of a summary
+    struct Totals {
+        uint64_t buckets[kNumStages][kNumBuckets];
+        uint64_t sum_nanos[kNumStages];
+        uint64_t counters[kNumCounters];
+        float gauges[kNumGauges];
+    };
+
+    // writes the newest totals it was given to the file, on its own thread
+    class FileWriter : public ofThread {
+    public:
+        ~FileWriter();
+
+        // copies totals and returns, started the first time
+        void write(const Totals& totals, const string& filename);
+
+    private:
+        // guarded by mutex
+        Totals pending;
+        string pending_filename;
+        bool has_pending = false;
+        std::condition_variable condition;
+
+        void threadedFunction() override;
+    };
+
+    FileWriter file_writer;
+
+    Telemetry();
+    static void writeFile(const Totals& totals, const string& filename);
+};
+
+
+// times its scope into a Stage
+class ScopedTimer {
+public:
+    ScopedTimer(Stage stage) : stage(stage), start(Telemetry::nanos()) {}
+    ~ScopedTimer()  { Telemetry::get().addTime(stage, Telemetry::nanos() - start); }
+
+private:
+    Stage stage;
+    uint64_t start;
+};
+
+}
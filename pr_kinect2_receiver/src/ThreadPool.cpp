@@ -0,0 +1,106 @@
+
+#include "ThreadPool.h"
+
+namespace pr {
+
+ThreadPool::ThreadPool(int num_threads) {
+    if(num_threads <= 0) num_threads = max(1u, std::thread::hardware_concurrency());
+    for(int i=0; i<num_threads; i++) workers.push_back(unique_ptr<Worker>(new Worker()));
+    for(int i=1; i<num_threads; i++) workers[i]->thread = std::thread(&ThreadPool::run, this, i);
+}
+
+
+ThreadPool::~ThreadPool() {
+    quit = true;
+    for(auto&& worker : workers) {
+        // lock so the notify can't slip in between a worker's check and its wait
+        { std::unique_lock<std::mutex> lock(worker->mutex); }
+        worker->wake.notify_all();
+    }
+    for(auto&& worker : workers) if(worker->thread.joinable()) worker->thread.join();
+}
+
+
+void ThreadPool::parallelFor(int n, const function<void(int)>& fn) {
+    if(n <= 0) return;
+
+    // not worth waking anyone
+    if(n == 1 || workers.size() == 1) {
+        for(int i=0; i<n; i++) fn(i);
+        return;
+    }
+
+    job = &fn;
+    remaining = n;
+
+    // worker w gets w, w + size, ... and only workers that got something are woken
+    int num_workers = workers.size();
+    int used = min(n, num_workers);
+    for(int w=0; w<used; w++) {
+        Worker& worker = *workers[w];
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            for(int i=w; i<n; i+=num_workers) worker.tasks.push_back(i);
+            worker.generation++;
+        }
+        if(w > 0) worker.wake.notify_one();
+    }
+
+    // help out, then wait for whatever is still running elsewhere
+    while(runOne(0));
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return remaining == 0; });
+    job = NULL;
+}
+
+
+bool ThreadPool::runOne(int self) {
+    int task = -1;
+
+    // own queue first, newest first
+    {
+        Worker& worker = *workers[self];
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        if(!worker.tasks.empty()) {
+            task = worker.tasks.back();
+            worker.tasks.pop_back();
+        }
+    }
+
+    // then steal the oldest from someone else
+    for(int i=1; task < 0 && i<workers.size(); i++) {
+        Worker& victim = *workers[(self + i) % workers.size()];
+        std::unique_lock<std::mutex> lock(victim.mutex);
+        if(!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+        }
+    }
+
+    if(task < 0) return false;
+
+    (*job)(task);
+    if(--remaining == 0) {
+        // lock so the notify can't slip in between parallelFor's check and its wait
+        std::unique_lock<std::mutex> lock(mutex);
+        done.notify_all();
+    }
+    return true;
+}
+
+
+void ThreadPool::run(int self) {
+    Worker& worker = *workers[self];
+    uint64_t seen = 0;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.wake.wait(lock, [&] { return quit || worker.generation != seen; });
+            if(quit) return;
+            seen = worker.generation;
+        }
+        while(runOne(self));
+    }
+}
+
+}
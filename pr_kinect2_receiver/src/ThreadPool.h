@@ -0,0 +1,48 @@
+/*
+ Small work stealing thread pool, for running the Receivers in parallel
+ - parallelFor() deals the indices out to the workers' queues (the calling thread is worker 0),
+   and wakes only the workers it gave something to. fewer indices than threads leaves the rest asleep
+ - a worker pops from the back of its own queue, and when that's empty steals from the front of the others'
+ - parallelFor() returns once every index has run, so the caller can carry on single threaded
+ */
+
+#pragma once
+
+#include "ofMain.h"
+
+namespace pr {
+
+class ThreadPool {
+public:
+    // num_threads including the calling thread, 0 for one per core
+    ThreadPool(int num_threads = 0);
+    ~ThreadPool();
+
+    // runs fn(i) for every i in [0, n), on the pool and the calling thread. blocks until all are done
+    void parallelFor(int n, const function<void(int)>& fn);
+
+    int numThreads() const  { return workers.size(); }
+
+private:
+    struct Worker {
+        std::mutex mutex;                   // guards tasks and generation
+        std::deque<int> tasks;
+        std::condition_variable wake;       // waits for tasks of a new job
+        uint64_t generation = 0;
+        std::thread thread;
+    };
+
+    vector<unique_ptr<Worker>> workers;     // [0] is the calling thread, it has no thread of its own
+
+    const function<void(int)>* job = NULL;
+    atomic<int> remaining { 0 };            // indices of the current job not finished yet
+
+    std::mutex mutex;                       // for done
+    std::condition_variable done;           // parallelFor waits for the last index
+    atomic<bool> quit { false };
+
+    void run(int self);
+    bool runOne(int self);
+};
+
+}
@@ -0,0 +1,41 @@
+/*
+ Hands the newest of a stream of values from one writer thread to one reader thread without either ever waiting.
+ The writer fills back() and publish()es it, the reader always gets the newest published value from front().
+ Values are never copied, the three buffers just change hands.
+ */
+
+#pragma once
+
+#include "ofMain.h"
+
+namespace pr {
+
+template<typename T>
+class TripleBuffer {
+public:
+    // writer: the buffer to fill next
+    T& back() { return buffers[back_index]; }
+
+    // writer: make back() the newest value, and get another buffer to fill
+    void publish() { back_index = present.exchange(back_index | kDirty, std::memory_order_acq_rel) & kIndex; }
+
+    // reader: newest published value. stays untouched until the next call
+    const T& front() {
+        if(present.load(std::memory_order_relaxed) & kDirty) front_index = present.exchange(front_index, std::memory_order_acq_rel) & kIndex;
+        return buffers[front_index];
+    }
+
+    // for setting up (e.g. reserving) all three before the threads start
+    T& operator[](int i) { return buffers[i]; }
+
+private:
+    static const int kIndex = 3;
+    static const int kDirty = 4;    // set while the present buffer hasn't been picked up by the reader
+
+    T buffers[3];
+    int back_index = 0;
+    atomic<int> present { 1 };
+    int front_index = 2;
+};
+
+}
@@ -1,32 +1,22 @@
 #include "ofMain.h"
 
-#include "Person.h"
-#include "Receiver.h"
+#include "Pipeline.h"
+#include "ConfigWatcher.h"
 #include "ofxImGui.h"
-#include "OscSender.h"
-
-#define kPersonAvg      0
-#define kPersonLeft     1
-#define kPersonRight    2
-#define kPersonCount    3
 
 #define kXmlFilename    "settings.xml"
 
 class ofApp : public ofBaseApp {
 
-    // the receivers
-    vector<pr::Receiver::Ptr> receivers;
+    // receivers, fusion and osc out, on their own thread
+    pr::Pipeline pipeline;
 
-    // the persons
-    vector<pr::Person::Ptr> persons_global_reduced; // list of final, condensed persons
-    vector<pr::Person::Ptr> persons_global_all;     // list of all persons from all receivers
+    // reloads settings when they change on disk, without holding up drawing or processing
+    pr::ConfigWatcher config;
 
     // for gui;
     ofxImGui gui;
 
-    // osc
-    pr::OscSender osc_sender;
-
     // display params
     struct {
         bool show_floor = true;
@@ -51,19 +41,18 @@ class ofApp : public ofBaseApp {
     void setup() {
         ofBackground(0);
         ofSetVerticalSync(true);
-        ofSetFrameRate(30);
-
-        // init and allocate 3x receivers (because we have 3x kinects - this number can be hardcoded for now)
-        receivers.resize(3);
-        for(int i=0; i<receivers.size(); i++) receivers[i] = shared_ptr<pr::Receiver>(new pr::Receiver(i+1));
+        ofSetFrameRate(60);
 
-		osc_sender.setup("127.0.0.1", 8000);
+        pipeline.setup();
 
-        // init number of final persons to 3 (completely coincidence that we have 3 receivers as well)
-        persons_global_reduced.resize(kPersonCount);
+        // creates the receivers
+        loadFromXml(kXmlFilename);
 
+        // processing runs at its own rate from here on, see Pipeline::rate
+        pipeline.start();
 
-        loadFromXml(kXmlFilename);
+        config.watch(kXmlFilename);
+        config.start();
 
         cam.setPosition(0, 2.5, 10);
         cam.lookAt(display.floor_pos, ofVec3f(0, 1, 0));
@@ -83,14 +72,14 @@ class ofApp : public ofBaseApp {
         // load xmml
         ofXml xml(filename);
 
-        // tell receivers to fetch their settings from loaded xml
-        for(auto&& receiver : receivers) {
-            if(receiver) receiver->loadFromXml(xml);
-            else ofLogError() << "App::loadFromXml receiver == NULL";
-        }
+        // receivers, sender etc.
+        pipeline.loadFromXml(xml);
 
-        osc_sender.loadFromXml(xml);
+        loadDisplayFromXml(xml);
+    }
 
+    //--------------------------------------------------------------
+    void loadDisplayFromXml(ofXml& xml) {
 		xml.setTo("//Settings/Display");
 		display.show_floor = xml.getBoolValue("show_floor");
 		display.draw_kinect_floors = xml.getBoolValue("draw_kinect_floors");
@@ -125,150 +114,34 @@ class ofApp : public ofBaseApp {
 		xml.addValue("show_vel", ofToString(display.show_vel));
 		xml.addValue("vel_mult", ofToString(display.vel_mult));
 
-		xml.setTo("//Settings");
-		xml.addChild("Receivers");
-		xml.setTo("Receivers");
-
-		xml.addValue("pos_smoothing", ofToString(receivers[0]->pos_smoothing));
-		xml.addValue("vel_smoothing", ofToString(receivers[0]->vel_smoothing));
-		xml.addValue("spring_strength", ofToString(receivers[0]->spring_strength));
-		xml.addValue("spring_damping", ofToString(receivers[0]->spring_damping));
-		xml.addValue("kill_frame_count", ofToString(receivers[0]->kill_frame_count));
-
-		// tell receivers to write the settings to xml to be saved
-		for (auto&& receiver : receivers) {
-			if (receiver) receiver->saveToXml(xml);
-			else ofLogError() << "App::saveToXml receiver == NULL";
-		}
-
-		osc_sender.saveToXml(xml);
+		// receivers, sender etc.
+		pipeline.saveToXml(xml);
 
         // save xml
         xml.save(filename);
+        config.saved(filename);
     }
 
 
 
     //--------------------------------------------------------------
     void update() {
-
-        // clear all persons list
-        persons_global_all.clear();
-
-        // first pass, parse all waiting osc, process receivers and add to global list of persons
-        for(auto&& receiver : receivers) {
-            if(receiver) receiver->update(persons_global_all);
-            else ofLogError() << "App::update receiver == NULL";
-        }
-
-        // if at least one person
-        if(persons_global_all.size() > 0) {
-            // sort global list
-            std::sort(persons_global_all.begin(), persons_global_all.end(), pr::Person::compare);
-            
-            if(persons_global_reduced.size() != kPersonCount) {
-                ofLogWarning() << "App::update persons_global_reduced.size() == " << persons_global_reduced.size() << ". Allocating";
-                persons_global_reduced.resize(kPersonCount);
-            }
-            
-            persons_global_reduced[kPersonLeft] = persons_global_all.front();
-            persons_global_reduced[kPersonRight] = persons_global_all.back();
-
-            // calculate average person (allocate first if nessecary)
-            if(!persons_global_reduced[kPersonAvg]) persons_global_reduced[kPersonAvg] = make_shared<pr::Person>();
-
-            if(persons_global_reduced[kPersonAvg] && persons_global_reduced[kPersonLeft] && persons_global_reduced[kPersonRight]) {
-                for(auto&& jkv : persons_global_reduced[kPersonAvg]->joints) {
-                    pr::JointInfo& joint = jkv.second;
-                    string jointName = jkv.first;
-                    joint.confidence    = (persons_global_reduced[kPersonLeft]->joints[jointName].confidence  + persons_global_reduced[kPersonRight]->joints[jointName].confidence)/2;
-                    joint.pos.current   = (persons_global_reduced[kPersonLeft]->joints[jointName].pos.current + persons_global_reduced[kPersonRight]->joints[jointName].pos.current)/2;
-                    joint.quat          = (persons_global_reduced[kPersonLeft]->joints[jointName].quat        + persons_global_reduced[kPersonRight]->joints[jointName].quat)/2;
-                    joint.euler         = (persons_global_reduced[kPersonLeft]->joints[jointName].euler       + persons_global_reduced[kPersonRight]->joints[jointName].euler)/2;
-                    joint.vel.current   = (persons_global_reduced[kPersonLeft]->joints[jointName].vel.current + persons_global_reduced[kPersonRight]->joints[jointName].vel.current)/2;
-                    joint.speed         = (persons_global_reduced[kPersonLeft]->joints[jointName].speed       + persons_global_reduced[kPersonRight]->joints[jointName].speed)/2;
-                    joint.vec           = (persons_global_reduced[kPersonLeft]->joints[jointName].vec         + persons_global_reduced[kPersonRight]->joints[jointName].vec)/2;
-                    joint.springy_pos   = (persons_global_reduced[kPersonLeft]->joints[jointName].springy_pos + persons_global_reduced[kPersonRight]->joints[jointName].springy_pos)/2;
-                    joint.springy_vel   = (persons_global_reduced[kPersonLeft]->joints[jointName].springy_vel + persons_global_reduced[kPersonRight]->joints[jointName].springy_vel)/2;
-                }
-            } else {
-                ofLogError() << "App::update one or more persons == NULL";
-            }
-        } else {
-            // if no one exists, don't send any person data
-            persons_global_reduced.clear();
+        // all processing happens on the pipeline's thread. settings changed on disk were parsed on the watcher's,
+        // display params are picked up here and the rest by the pipeline before its next tick
+        shared_ptr<ofXml> xml = config.take(kXmlFilename);
+        if(xml) {
+            loadDisplayFromXml(*xml);
+            pipeline.queueXml(xml);
         }
-
-        // send osc
-        sendOsc();
     }
 
 
-    //--------------------------------------------------------------
-    void sendOsc() {
-        ofxOscBundle b;
-
-        // send metadata
-        ofxOscMessage m;
-        m.setAddress("/meta");
-        m.addInt32Arg(persons_global_reduced.size());
-        b.addMessage(m);
-
-        int i=0;
-        for(auto&& person: persons_global_reduced) {
-            if(person) {
-                for(auto&& jkv : person->joints) {
-                    pr::JointInfo& joint = jkv.second;
-                    string jointName = jkv.first;
-
-                    ofxOscMessage m;
-                    m.setAddress("/skel/" + ofToString(i) + "/" + jointName);
-                    m.addFloatArg(joint.pos.current.x);
-                    m.addFloatArg(joint.pos.current.y);
-                    m.addFloatArg(joint.pos.current.z);
-
-                    m.addFloatArg(joint.quat._v.x);
-                    m.addFloatArg(joint.quat._v.y);
-                    m.addFloatArg(joint.quat._v.z);
-                    m.addFloatArg(joint.quat._v.w);
-
-                    m.addFloatArg(joint.euler.x);
-                    m.addFloatArg(joint.euler.y);
-                    m.addFloatArg(joint.euler.z);
-
-                    m.addFloatArg(joint.vel.current.x);
-                    m.addFloatArg(joint.vel.current.y);
-                    m.addFloatArg(joint.vel.current.z);
-
-                    m.addFloatArg(joint.speed);
-
-                    m.addFloatArg(joint.vec.x);
-                    m.addFloatArg(joint.vec.y);
-                    m.addFloatArg(joint.vec.z);
-
-                    m.addFloatArg(joint.springy_pos.x);
-                    m.addFloatArg(joint.springy_pos.y);
-                    m.addFloatArg(joint.springy_pos.z);
-
-                    m.addFloatArg(joint.springy_vel.x);
-                    m.addFloatArg(joint.springy_vel.y);
-                    m.addFloatArg(joint.springy_vel.z);
-
-                    b.addMessage(m);
-                }
-            } else {
-                ofLogError() << "App::sendOsc person == NULL";
-            }
-            i++;
-        }
-        osc_sender.sendBundle(b);
-    }
-
-
-
     //--------------------------------------------------------------
     void draw() {
 
+        // whatever the pipeline published last
+        const pr::Snapshot& snapshot = pipeline.getSnapshot();
+
         cam.begin();
 
         if(display.show_floor) {
@@ -281,30 +154,31 @@ class ofApp : public ofBaseApp {
         }
 
         if(display.show_all_persons) {
-            for(auto&& person: persons_global_all) {
-                if(person) person->draw(display.joint_radius, display.show_target_pos, display.show_springy_pos, display.show_vel, display.vel_mult);
+            for(auto&& person: snapshot.persons_all) {
+                person.draw(display.joint_radius, display.show_target_pos, display.show_springy_pos, display.show_vel, display.vel_mult);
             }
         }
 
         if(display.show_reduced_persons) {
-            for(auto&& person: persons_global_reduced) {
-                if(person) person->draw(display.joint_radius, display.show_target_pos, display.show_springy_pos, display.show_vel, display.vel_mult);
+            for(auto&& person: snapshot.persons_reduced) {
+                person.draw(display.joint_radius, display.show_target_pos, display.show_springy_pos, display.show_vel, display.vel_mult);
             }
         }
         
-        for (auto&& receiver : receivers) {
-            if(receiver->isEnabled()) {
+        for (auto&& sensor : snapshot.sensors) {
+            if(sensor.enabled) {
                 // draw axis for kinect pos/rot
-                receiver->getNode().transformGL();
+                ofPushMatrix();
+                ofMultMatrix(sensor.matrix);
                 ofDrawAxis(0.5);
-                receiver->getNode().restoreTransformGL();
+                ofPopMatrix();
 
                 if (display.draw_kinect_floors) {
                     ofPlanePrimitive k_floor_plane(4, 4, 4, 4);
                     //                    k_floor_plane.setWidth(4.0);
                     //                    k_floor_plane.setHeight(4.0);
-                    k_floor_plane.setOrientation(ofQuaternion(1, 0, 0, 1)*receiver->floorQuat);
-                    k_floor_plane.setPosition(receiver->getNode().getGlobalPosition());
+                    k_floor_plane.setOrientation(ofQuaternion(1, 0, 0, 1)*sensor.floor_quat);
+                    k_floor_plane.setPosition(sensor.matrix.getTranslation());
                     ofPushStyle();
                     ofSetColor(200);
                     k_floor_plane.drawWireframe();
@@ -316,31 +190,20 @@ class ofApp : public ofBaseApp {
 
         cam.end();
 
-        drawGui();
+        drawGui(snapshot);
         
         ofDrawBitmapString(ofToString(ofGetFrameRate(), 2), 30, 20);
     }
 
 
     //--------------------------------------------------------------
-    void drawGui() {
+    void drawGui(const pr::Snapshot& snapshot) {
 
         gui.begin();
         //        ImGui::ShowWindow("PR_PERSONS_RECEIVER", null, true, true);
 
-        ImGui::CollapsingHeader("Global Params", NULL, true, true);
-        ImGui::SliderFloat("pos smoothing", &pr::Receiver::pos_smoothing, 0, 1);
-        ImGui::SliderFloat("vel smoothing", &pr::Receiver::vel_smoothing, 0, 1);
-        ImGui::SliderFloat("spring strength", &pr::Receiver::spring_strength, 0, 1);
-        ImGui::SliderFloat("spring damping", &pr::Receiver::spring_damping, 0, 1);
-        ImGui::SliderInt("kill frame count", &pr::Receiver::kill_frame_count, 0, 200);
-
-        for(auto&& receiver : receivers) {
-            if(receiver) receiver->drawGui();
-            else ofLogError() << "App::drawGui receiver == NULL";
-        }
-
-        osc_sender.drawGui();
+        // params, receivers, sender
+        pipeline.drawGui(snapshot);
 
         // display params
         ImGui::CollapsingHeader("Display params", NULL, true, true);
@@ -359,9 +222,12 @@ class ofApp : public ofBaseApp {
         // show stats
         ImGui::CollapsingHeader("Global Stats", NULL, true, true);
         stringstream str;
-        str << "Total persons: " << persons_global_all.size() << endl;
+        str << "Total persons: " << snapshot.persons_all.size() << endl;
+        str << "Unique persons: " << snapshot.num_unique << " (" << snapshot.num_tracks << " tracks, " << ofToString(snapshot.associator_millis, 3) << "ms)" << endl;
+        str << "Tick: " << ofToString(snapshot.tick_millis, 3) << "ms" << endl;
         str << "fps: " << ofGetFrameRate();
         ImGui::Text(str.str().c_str());
+        pr::Telemetry::get().drawGui();
 
 
         gui.end();
@@ -371,7 +237,7 @@ class ofApp : public ofBaseApp {
     //--------------------------------------------------------------
     void keyPressed(int key) {
         switch(key) {
-        case 'l' :loadFromXml(kXmlFilename); break;
+        case 'l' :config.reload(); break;
         case 's' :saveToXml(kXmlFilename); break;
 		case 'v':
                 cam.setPosition(0, 2.5, 10);
@@ -383,6 +249,12 @@ class ofApp : public ofBaseApp {
         }
     }
 
+    //--------------------------------------------------------------
+    void exit() {
+        config.stop();
+        pipeline.stop();
+    }
+
     //--------------------------------------------------------------
     void keyReleased(int key) {
 
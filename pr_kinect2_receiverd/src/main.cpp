@@ -0,0 +1,165 @@
+/*
+ Headless receiver, for running unattended as a service (see pr_kinect2_receiverd.service)
+ - same processing as pr_kinect2_receiver (its src is compiled in with PR_HEADLESS), no window, GL or ImGui
+ - reads settings.xml and joints.xml from the gui app's data folder, or from the folder given as the first argument
+ - settings.xml is reloaded when it changes (see ConfigWatcher) or on SIGHUP, SIGTERM / SIGINT shut down cleanly
+ - --record records all incoming datagrams to a new file in recordings/, --record=file to file (see PacketLog.h)
+ - --replay file plays a recording instead of listening (--speed x, --fast, --loop), and exits when it's done.
+   e.g. --replay crowd.prlog --fast to benchmark on a recording
+ */
+
+#include "ofMain.h"
+#include "ofAppNoWindow.h"
+
+#include "Pipeline.h"
+#include "ConfigWatcher.h"
+
+#include <csignal>
+
+#define kXmlFilename        "settings.xml"
+#define kDefaultDataPath    "../../pr_kinect2_receiver/bin/data/"     // relative to the executable
+#define kStatsInterval      60      // seconds between stats in the log
+
+// set from the signal handlers, picked up in update()
+static volatile sig_atomic_t reload_requested = 0;
+static volatile sig_atomic_t exit_requested = 0;
+
+static void onSignal(int sig) {
+    if(sig == SIGHUP) reload_requested = 1;
+    else exit_requested = 1;
+}
+
+
+class ofApp : public ofBaseApp {
+public:
+    string data_path;
+    bool record = false;
+    string record_path;     // "" for a timestamped one
+    string replay_path;
+    float replay_speed = 1;
+    bool replay_fast = false;
+    bool replay_loop = false;
+
+    // receivers, fusion and osc out, on their own thread
+    pr::Pipeline pipeline;
+
+    // parses settings.xml again when it changes, applied between two of the pipeline's ticks
+    pr::ConfigWatcher config;
+
+    float last_stats_time = 0;
+    float replay_start_time = -1;
+
+
+    //--------------------------------------------------------------
+    void setup() {
+        // nothing to draw, only need to check for signals now and then
+        ofSetFrameRate(10);
+
+        ofSetDataPathRoot(data_path);
+        ofLogNotice() << "pr_kinect2_receiverd: data path " << ofToDataPath("", true);
+
+        std::signal(SIGHUP, onSignal);
+        std::signal(SIGTERM, onSignal);
+        std::signal(SIGINT, onSignal);
+
+        pipeline.setup();
+
+        // creates the receivers
+        loadFromXml(kXmlFilename);
+
+        if(record) pipeline.startRecording(record_path);
+        if(!replay_path.empty()) {
+            pipeline.replay_speed = replay_speed;
+            pipeline.replay_fast = replay_fast;
+            pipeline.replay_loop = replay_loop;
+            if(!pipeline.startReplay(replay_path)) {
+                ofExit(1);
+                return;
+            }
+            replay_start_time = ofGetElapsedTimef();
+        }
+
+        pipeline.start();
+
+        config.watch(kXmlFilename);
+        config.start();
+    }
+
+
+    //--------------------------------------------------------------
+    void loadFromXml(string filename) {
+        ofXml xml;
+        if(!xml.load(filename)) {
+            ofLogError() << "pr_kinect2_receiverd: couldn't load " << ofToDataPath(filename, true);
+            return;
+        }
+        pipeline.loadFromXml(xml);
+        ofLogNotice() << "pr_kinect2_receiverd: loaded " << ofToDataPath(filename, true);
+    }
+
+
+    //--------------------------------------------------------------
+    void update() {
+        if(exit_requested) {
+            ofLogNotice() << "pr_kinect2_receiverd: shutting down";
+            ofExit();
+            return;
+        }
+
+        // done with the replay we were started for
+        if(replay_start_time >= 0 && !pipeline.isReplaying()) {
+            const pr::Snapshot& snapshot = pipeline.getSnapshot();
+            ofLogNotice() << "pr_kinect2_receiverd: replay done in " << ofToString(ofGetElapsedTimef() - replay_start_time, 1) << "s, last tick " << ofToString(snapshot.tick_millis, 3) << "ms";
+            ofExit();
+            return;
+        }
+
+        if(reload_requested) {
+            reload_requested = 0;
+            config.reload();
+        }
+
+        shared_ptr<ofXml> xml = config.take(kXmlFilename);
+        if(xml) pipeline.queueXml(xml);
+
+        // nobody is watching a gui, so say how things are going once in a while
+        float now = ofGetElapsedTimef();
+        if(now - last_stats_time > kStatsInterval) {
+            last_stats_time = now;
+            const pr::Snapshot& snapshot = pipeline.getSnapshot();
+            ofLogNotice() << "pr_kinect2_receiverd: " << snapshot.persons_all.size() << " persons, " << snapshot.num_unique << " unique, tick " << ofToString(snapshot.tick_millis, 3) << "ms";
+        }
+    }
+
+
+    //--------------------------------------------------------------
+    void exit() {
+        config.stop();
+        pipeline.stop();
+    }
+};
+
+//========================================================================
+int main(int argc, char* argv[]) {
+    ofAppNoWindow window;
+    ofSetupOpenGL(&window, 0, 0, OF_WINDOW);    // no GL context, just the main loop
+
+    ofApp* app = new ofApp();
+    app->data_path = ofFilePath::join(ofFilePath::getCurrentExeDir(), kDefaultDataPath);
+    for(int i=1; i<argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc && argv[i + 1][0] != '-';
+        if(arg == "--record") app->record = true;
+        else if(arg.compare(0, 9, "--record=") == 0) {
+            app->record = true;
+            app->record_path = arg.substr(9);
+        }
+        else if(arg == "--replay" && has_value) app->replay_path = argv[++i];
+        else if(arg == "--speed" && has_value) app->replay_speed = ofToFloat(argv[++i]);
+        else if(arg == "--fast") app->replay_fast = true;
+        else if(arg == "--loop") app->replay_loop = true;
+        else if(arg[0] != '-') app->data_path = arg;
+        else ofLogError() << "pr_kinect2_receiverd: unknown argument " << arg;
+    }
+    ofRunApp(app);
+}
@@ -0,0 +1,151 @@
+#include "AppearanceDescriptor.h"
+
+#include <emmintrin.h>
+
+// joints spanning the torso region, used to find its bounding box in depth space
+static const JointType torsoJoints[] = {
+	JointType_SpineShoulder, JointType_ShoulderLeft, JointType_ShoulderRight,
+	JointType_SpineMid, JointType_SpineBase, JointType_HipLeft, JointType_HipRight
+};
+static const int numTorsoJoints = sizeof(torsoJoints) / sizeof(torsoJoints[0]);
+
+//--------------------------------------------------------------
+AppearanceDescriptor::AppearanceDescriptor() {
+	bEnabled = true;
+	intervalFrames = 15;
+	sampleStride = 2;
+	frameCounter = 0;
+	memset(descriptors, 0, sizeof(descriptors));
+}
+
+//--------------------------------------------------------------
+bool AppearanceDescriptor::update(ofxKFW2::Device & kinect, const vector<ofxKFW2::Data::Body> & bodies) {
+	if (!bEnabled) return false;
+
+	// only compute at a low rate, appearance doesn't change quickly
+	if (frameCounter++ % max(intervalFrames, 1) != 0) return false;
+
+	ICoordinateMapper * mapper = NULL;
+	if (kinect.getSensor() == NULL || FAILED(kinect.getSensor()->get_CoordinateMapper(&mapper))) {
+		ofLogWarning("AppearanceDescriptor::update unable to get coordinate mapper");
+		return false;
+	}
+
+	const ofShortPixels & depth = kinect.getDepthSource()->getPixels();
+	const ofPixels & bodyIndex = kinect.getBodyIndexSource()->getPixels();
+	const ofPixels & color = kinect.getColorSource()->getPixels();
+
+	for (auto & body : bodies) {
+		if (body.bodyId < 0 || body.bodyId >= BODY_COUNT) continue;
+		descriptors[body.bodyId].valid = false;
+		if (!body.tracked || !depth.isAllocated() || !bodyIndex.isAllocated() || !color.isAllocated()) continue;
+
+		computeBody(body, depth, bodyIndex, color, mapper);
+	}
+
+	mapper->Release();
+	return true;
+}
+
+//--------------------------------------------------------------
+void AppearanceDescriptor::computeBody(const ofxKFW2::Data::Body & body, const ofShortPixels & depth,
+	const ofPixels & bodyIndex, const ofPixels & color, ICoordinateMapper * mapper) {
+
+	Descriptor & descriptor = descriptors[body.bodyId];
+
+	// project the torso joints into depth space to get the region to sample
+	CameraSpacePoint cameraPoints[numTorsoJoints];
+	DepthSpacePoint torsoPoints[numTorsoJoints];
+	for (int i = 0; i < numTorsoJoints; i++) {
+		ofVec3f p = body.joints.at(torsoJoints[i]).getPosition();
+		cameraPoints[i].X = p.x;
+		cameraPoints[i].Y = p.y;
+		cameraPoints[i].Z = p.z;
+	}
+	if (FAILED(mapper->MapCameraPointsToDepthSpace(numTorsoJoints, cameraPoints, numTorsoJoints, torsoPoints))) return;
+
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	for (int i = 0; i < numTorsoJoints; i++) {
+		// unmappable points come back as -inf
+		if (!isfinite(torsoPoints[i].X) || !isfinite(torsoPoints[i].Y)) continue;
+		minX = min(minX, torsoPoints[i].X);
+		minY = min(minY, torsoPoints[i].Y);
+		maxX = max(maxX, torsoPoints[i].X);
+		maxY = max(maxY, torsoPoints[i].Y);
+	}
+	if (minX > maxX) return;
+
+	int depthWidth = depth.getWidth();
+	int depthHeight = depth.getHeight();
+	int x0 = ofClamp(minX, 0, depthWidth - 1);
+	int x1 = ofClamp(maxX, 0, depthWidth - 1);
+	int y0 = ofClamp(minY, 0, depthHeight - 1);
+	int y1 = ofClamp(maxY, 0, depthHeight - 1);
+	int stride = max(sampleStride, 1);
+
+	// collect depth pixels inside the region that belong to this body
+	depthPoints.clear();
+	depthValues.clear();
+	const UINT16 * depthData = depth.getData();
+	const unsigned char * indexData = bodyIndex.getData();
+	for (int y = y0; y <= y1; y += stride) {
+		for (int x = x0; x <= x1; x += stride) {
+			int i = y * depthWidth + x;
+			if (indexData[i] != body.bodyId || depthData[i] == 0) continue;
+			DepthSpacePoint dp = { float(x), float(y) };
+			depthPoints.push_back(dp);
+			depthValues.push_back(depthData[i]);
+		}
+	}
+	if (depthPoints.empty()) return;
+
+	// look the body pixels up in the color frame
+	colorPoints.resize(depthPoints.size());
+	if (FAILED(mapper->MapDepthPointsToColorSpace(depthPoints.size(), depthPoints.data(), depthValues.size(),
+		depthValues.data(), colorPoints.size(), colorPoints.data()))) return;
+
+	samples.clear();
+	int colorWidth = color.getWidth();
+	int colorHeight = color.getHeight();
+	const unsigned int * colorData = (const unsigned int *)color.getData();
+	for (auto & cp : colorPoints) {
+		int cx = int(cp.X + 0.5f);
+		int cy = int(cp.Y + 0.5f);
+		if (cx < 0 || cx >= colorWidth || cy < 0 || cy >= colorHeight) continue;
+		samples.push_back(colorData[cy * colorWidth + cx]);
+	}
+	if (samples.empty()) return;
+
+	// quantize RGBA samples to bin indices 4 at a time (pixels are RGBA bytes,
+	// so little endian r is the low byte). keep the top 2 bits of each channel:
+	// bin = (r >> 6) << 4 | (g >> 6) << 2 | (b >> 6)
+	memset(histogram, 0, sizeof(histogram));
+	const __m128i mask = _mm_set1_epi32(APPEARANCE_LEVELS - 1);
+	size_t n = samples.size();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i px = _mm_loadu_si128((const __m128i *)&samples[i]);
+		__m128i r = _mm_and_si128(_mm_srli_epi32(px, 6), mask);
+		__m128i g = _mm_and_si128(_mm_srli_epi32(px, 14), mask);
+		__m128i b = _mm_and_si128(_mm_srli_epi32(px, 22), mask);
+		__m128i bin = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 4), _mm_slli_epi32(g, 2)), b);
+
+		unsigned int bins[4];
+		_mm_storeu_si128((__m128i *)bins, bin);
+		histogram[bins[0]]++;
+		histogram[bins[1]]++;
+		histogram[bins[2]]++;
+		histogram[bins[3]]++;
+	}
+	for (; i < n; i++) {
+		unsigned int px = samples[i];
+		histogram[(((px >> 6) & 3) << 4) | (((px >> 14) & 3) << 2) | ((px >> 22) & 3)]++;
+	}
+
+	// normalize so the descriptor doesn't depend on how big the person appears
+	for (int b = 0; b < APPEARANCE_BINS; b++) {
+		descriptor.bins[b] = (unsigned char)((histogram[b] * 255 + n / 2) / n);
+	}
+	descriptor.sampleCount = n;
+	descriptor.valid = true;
+}
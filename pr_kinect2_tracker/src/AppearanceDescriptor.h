@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxKinectForWindows2.h"
+
+// number of quantization levels per color channel (4 levels -> 2 bits per channel)
+#define APPEARANCE_LEVELS 4
+#define APPEARANCE_BINS (APPEARANCE_LEVELS * APPEARANCE_LEVELS * APPEARANCE_LEVELS)
+
+// computes a coarse color histogram of the torso of each tracked body.
+// pixels are taken from the depth frame through the body index mask and
+// looked up in the color frame with the Kinect coordinate mapper, so only
+// pixels that actually belong to the body are counted.
+class AppearanceDescriptor {
+
+	public:
+		// one compact descriptor per body, normalized so the bins sum to ~255
+		struct Descriptor {
+			unsigned char	bins[APPEARANCE_BINS];
+			int				sampleCount;
+			bool			valid;
+		};
+
+		AppearanceDescriptor();
+
+		// returns true if the descriptors were recomputed this frame
+		// (only happens every intervalFrames frames)
+		bool update(ofxKFW2::Device & kinect, const vector<ofxKFW2::Data::Body> & bodies);
+
+		const Descriptor & get(int bodyId) const { return descriptors[bodyId]; }
+
+		bool			bEnabled;
+		int				intervalFrames;		// compute every N frames
+		int				sampleStride;		// sample every Nth depth pixel in x and y
+
+	protected:
+		void computeBody(const ofxKFW2::Data::Body & body, const ofShortPixels & depth,
+			const ofPixels & bodyIndex, const ofPixels & color, ICoordinateMapper * mapper);
+
+		Descriptor					descriptors[BODY_COUNT];
+		int							frameCounter;
+
+		// scratch buffers, reused between frames
+		vector<DepthSpacePoint>		depthPoints;
+		vector<UINT16>				depthValues;
+		vector<ColorSpacePoint>		colorPoints;
+		vector<unsigned int>		samples;
+		unsigned int				histogram[APPEARANCE_BINS];
+};
@@ -0,0 +1,39 @@
+#include "CaptureThread.h"
+
+//--------------------------------------------------------------
+CaptureThread::CaptureThread() {
+	intervalMicros = 0;
+}
+
+//--------------------------------------------------------------
+CaptureThread::~CaptureThread() {
+	stop();
+}
+
+//--------------------------------------------------------------
+void CaptureThread::start(float fps, std::function<void()> frame) {
+	if (isThreadRunning()) return;
+	intervalMicros = 1000000 / max(fps, 1.0f);
+	this->frame = frame;
+	startThread();
+}
+
+//--------------------------------------------------------------
+void CaptureThread::stop() {
+	if (!isThreadRunning()) return;
+	stopThread();
+	waitForThread(false);
+}
+
+//--------------------------------------------------------------
+void CaptureThread::threadedFunction() {
+	uint64_t next = ofGetElapsedTimeMicros();
+	while (isThreadRunning()) {
+		frame();
+
+		next += intervalMicros;
+		uint64_t now = ofGetElapsedTimeMicros();
+		if (next > now) std::this_thread::sleep_for(std::chrono::microseconds(next - now));
+		else next = now;
+	}
+}
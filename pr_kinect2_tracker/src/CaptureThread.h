@@ -0,0 +1,23 @@
+#pragma once
+
+#include "ofMain.h"
+
+// calls a function at a fixed rate on a thread of its own. the tracker runs
+// the kinect capture and the osc send on it, so skeletons go out at the sensor
+// rate however long the window takes to draw. a call that runs late doesn't
+// make the next ones bunch up, the clock starts over from there.
+class CaptureThread : public ofThread {
+
+	public:
+		CaptureThread();
+		~CaptureThread();
+
+		void start(float fps, std::function<void()> frame);
+		void stop();
+
+	protected:
+		void threadedFunction();
+
+		uint64_t					intervalMicros;
+		std::function<void()>		frame;
+};
@@ -0,0 +1,121 @@
+#include "OutputChannel.h"
+
+//--------------------------------------------------------------
+OutputChannel::OutputChannel() {
+	mode = EVERY_FRAME;
+	rateHz = 5;
+	keepAlive = 1;
+	threshold = 0;
+	numSent = 0;
+	numSkipped = 0;
+	now = 0;
+	frameNum = 0;
+}
+
+//--------------------------------------------------------------
+void OutputChannel::loadXml(ofxXmlSettings & settings, const string & tag, Mode defaultMode) {
+	static const string modeNames[] = { "every_frame", "on_change", "rate" };
+
+	Mode oldMode = mode;
+	float oldRateHz = rateHz;
+	float oldKeepAlive = keepAlive;
+	float oldThreshold = threshold;
+
+	mode = defaultMode;
+	if (settings.tagExists(tag)) {
+		settings.pushTag(tag);
+		string modeName = settings.getValue("mode", modeNames[defaultMode]);
+		for (int i = 0; i < 3; i++) {
+			if (modeName == modeNames[i]) mode = Mode(i);
+		}
+		rateHz = settings.getValue("rateHz", rateHz);
+		keepAlive = settings.getValue("keepAlive", keepAlive);
+		threshold = settings.getValue("threshold", threshold);
+		settings.popTag();
+	}
+
+	// new policy, start over. reloading the same one keeps what was sent,
+	// so it doesn't all go out again at once
+	if (mode != oldMode || rateHz != oldRateHz || keepAlive != oldKeepAlive || threshold != oldThreshold) {
+		entries.clear();
+	}
+}
+
+//--------------------------------------------------------------
+void OutputChannel::beginFrame(float time) {
+	now = time;
+	frameNum++;
+	numSent = 0;
+	numSkipped = 0;
+}
+
+//--------------------------------------------------------------
+bool OutputChannel::add(ofxOscBundle & bundle, const ofxOscMessage & m) {
+	if (mode == EVERY_FRAME) {
+		bundle.addMessage(m);
+		numSent++;
+		return true;
+	}
+
+	auto it = entries.find(m.getAddress());
+	bool send = false;
+
+	if (it == entries.end()) {
+		// never sent (or forgotten), always send
+		it = entries.insert(make_pair(m.getAddress(), Entry())).first;
+		send = true;
+	}
+	else {
+		float elapsed = now - it->second.sentTime;
+		if (elapsed >= keepAlive) send = true;
+		else if (mode == RATE && elapsed < 1.0 / max(rateHz, 0.001f)) send = false;
+		else send = changed(m, it->second.message);
+	}
+
+	Entry & entry = it->second;
+	entry.seenFrame = frameNum;
+
+	if (send) {
+		entry.message = m;
+		entry.sentTime = now;
+		bundle.addMessage(m);
+		numSent++;
+	}
+	else {
+		numSkipped++;
+	}
+	return send;
+}
+
+//--------------------------------------------------------------
+void OutputChannel::endFrame() {
+	for (auto it = entries.begin(); it != entries.end(); ) {
+		if (it->second.seenFrame != frameNum) it = entries.erase(it);
+		else ++it;
+	}
+}
+
+//--------------------------------------------------------------
+bool OutputChannel::changed(const ofxOscMessage & a, const ofxOscMessage & b) const {
+	if (a.getNumArgs() != b.getNumArgs()) return true;
+
+	for (int i = 0; i < a.getNumArgs(); i++) {
+		if (a.getArgType(i) != b.getArgType(i)) return true;
+
+		switch (a.getArgType(i)) {
+		case OFXOSC_TYPE_FLOAT:
+			if (fabs(a.getArgAsFloat(i) - b.getArgAsFloat(i)) > threshold) return true;
+			break;
+		case OFXOSC_TYPE_INT32:
+			if (a.getArgAsInt32(i) != b.getArgAsInt32(i)) return true;
+			break;
+		case OFXOSC_TYPE_STRING:
+			if (a.getArgAsString(i) != b.getArgAsString(i)) return true;
+			break;
+		default:
+			// can't compare, treat as changed
+			return true;
+		}
+	}
+	return false;
+}
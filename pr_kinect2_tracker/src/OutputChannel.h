@@ -0,0 +1,62 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOsc.h"
+#include "ofxXmlSettings.h"
+
+// decides per frame which messages of one message class (e.g. all /lean/userID
+// messages) go into the outgoing bundle, so slow changing data isn't resent
+// every frame.
+//
+// modes:
+//	every_frame	send every message every frame (the old behaviour)
+//	on_change	send a message when its arguments changed by more than threshold,
+//				or when keepAlive seconds passed since it was last sent
+//	rate		like on_change, but send each address at most rateHz times a second
+//
+// the keep alive makes sure receivers that start late still get in sync
+class OutputChannel {
+
+	public:
+		enum Mode {
+			EVERY_FRAME,
+			ON_CHANGE,
+			RATE
+		};
+
+		OutputChannel();
+
+		// reads <tag><mode/><rateHz/><keepAlive/><threshold/></tag> from the current level
+		void loadXml(ofxXmlSettings & settings, const string & tag, Mode defaultMode);
+
+		// call once per frame before any messages are offered
+		void beginFrame(float time);
+
+		// adds m to bundle if the policy allows it. returns true if it was added
+		bool add(ofxOscBundle & bundle, const ofxOscMessage & m);
+
+		// forget addresses that weren't offered this frame (e.g. lost users),
+		// so they are sent straight away when they come back
+		void endFrame();
+
+		Mode		mode;
+		float		rateHz;
+		float		keepAlive;
+		float		threshold;
+
+		int			numSent;
+		int			numSkipped;
+
+	protected:
+		struct Entry {
+			ofxOscMessage	message;
+			float			sentTime;
+			int				seenFrame;
+		};
+
+		bool changed(const ofxOscMessage & a, const ofxOscMessage & b) const;
+
+		map<string, Entry>	entries;
+		float				now;
+		int					frameNum;
+};
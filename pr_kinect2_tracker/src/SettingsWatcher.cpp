@@ -0,0 +1,120 @@
+#include "SettingsWatcher.h"
+
+#include <sys/stat.h>
+
+//--------------------------------------------------------------
+SettingsWatcher::SettingsWatcher() {
+	pollMillis = 500;
+	settleMillis = 200;
+	bReloadRequested = false;
+}
+
+//--------------------------------------------------------------
+SettingsWatcher::~SettingsWatcher() {
+	stop();
+}
+
+//--------------------------------------------------------------
+void SettingsWatcher::watch(const string & filename) {
+	File file;
+	file.filename = filename;
+	file.path = ofToDataPath(filename, true);
+	file.changedMillis = 0;
+	file.bDirty = false;
+	files.push_back(file);
+}
+
+//--------------------------------------------------------------
+void SettingsWatcher::start() {
+	if (isThreadRunning()) return;
+
+	// what's there now was loaded at startup
+	for (auto & file : files) {
+		stat(file.path, file.seenTime, file.seenSize);
+		file.loadedTime = file.seenTime;
+		file.loadedSize = file.seenSize;
+	}
+	startThread();
+}
+
+//--------------------------------------------------------------
+void SettingsWatcher::stop() {
+	if (!isThreadRunning()) return;
+	stopThread();
+	waitForThread(false);
+}
+
+//--------------------------------------------------------------
+void SettingsWatcher::reload() {
+	bReloadRequested = true;
+}
+
+//--------------------------------------------------------------
+shared_ptr<ofxXmlSettings> SettingsWatcher::take(const string & filename) {
+	std::unique_lock<std::mutex> lock(mutex);
+	shared_ptr<ofxXmlSettings> parsed;
+	for (auto & file : files) {
+		if (file.filename == filename) parsed.swap(file.parsed);
+	}
+	return parsed;
+}
+
+//--------------------------------------------------------------
+void SettingsWatcher::threadedFunction() {
+	bool bSettling = false;
+	while (isThreadRunning()) {
+		// back sooner while a change is settling
+		ofSleepMillis(bSettling ? settleMillis : pollMillis);
+		uint64_t now = ofGetElapsedTimeMillis();
+		bool bForce = bReloadRequested.exchange(false);
+		bSettling = false;
+		for (auto & file : files) bSettling |= check(file, now, bForce);
+	}
+}
+
+//--------------------------------------------------------------
+bool SettingsWatcher::check(File & file, uint64_t now, bool bForce) {
+	int64_t time, size;
+	stat(file.path, time, size);
+
+	if (time != file.seenTime || size != file.seenSize) {
+		file.seenTime = time;
+		file.seenSize = size;
+		file.changedMillis = now;
+	}
+	file.bDirty = file.bDirty || bForce || file.seenTime != file.loadedTime || file.seenSize != file.loadedSize;
+
+	// a file that's gone (e.g. halfway through being replaced) loads when it's back
+	bool bSettled = bForce || now - file.changedMillis >= settleMillis;
+	if (!file.bDirty || !bSettled || !time) return file.bDirty;
+
+	file.bDirty = false;
+	file.loadedTime = time;
+	file.loadedSize = size;
+
+	// the slow part, nothing waits on it
+	shared_ptr<ofxXmlSettings> settings(new ofxXmlSettings());
+	if (!settings->loadFile(file.path)) {
+		ofLogError("SettingsWatcher") << "couldn't parse " << file.path << ", keeping the settings in use";
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	file.parsed = settings;
+	ofLogNotice("SettingsWatcher") << "loaded " << file.path;
+	return false;
+}
+
+//--------------------------------------------------------------
+void SettingsWatcher::stat(const string & path, int64_t & time, int64_t & size) {
+	// only seconds, the size catches most saves within one
+	struct ::stat st;
+	if (::stat(path.c_str(), &st) == 0) {
+		time = st.st_mtime;
+		size = st.st_size;
+	}
+	else {
+		time = 0;
+		size = 0;
+	}
+}
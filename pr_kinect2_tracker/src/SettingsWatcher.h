@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxXmlSettings.h"
+
+// reloads xml settings files when they change on disk, so settings can be
+// tuned while the tracker is running. the files are checked and parsed on a
+// thread of their own, the capture loop never waits on the disk, it only
+// picks up what was parsed with take() at the start of a frame.
+//
+// a change is only loaded once the file has stayed the same for settleMillis,
+// editors write in more than one go. a file that doesn't parse is logged and
+// skipped, whatever was loaded before stays in use.
+class SettingsWatcher : public ofThread {
+
+	public:
+		SettingsWatcher();
+		~SettingsWatcher();
+
+		// filename in data, before start()
+		void watch(const string & filename);
+
+		void start();
+		void stop();
+
+		// parse all watched files again, changed or not
+		void reload();
+
+		// newest parse of filename since the last take(), NULL if there is none
+		shared_ptr<ofxXmlSettings> take(const string & filename);
+
+		int							pollMillis;		// how often the files are checked
+		int							settleMillis;
+
+	protected:
+		struct File {
+			string						filename;
+			string						path;
+			int64_t						seenTime;		// modification time and size when last checked
+			int64_t						seenSize;
+			int64_t						loadedTime;		// and when last parsed
+			int64_t						loadedSize;
+			uint64_t					changedMillis;	// when they last changed
+			bool						bDirty;			// changed, waiting to settle
+			shared_ptr<ofxXmlSettings>	parsed;
+		};
+
+		void threadedFunction();
+		bool check(File & file, uint64_t now, bool bForce);
+		static void stat(const string & path, int64_t & time, int64_t & size);
+
+		// fixed once started and only touched by the watcher thread, except parsed (guarded by mutex)
+		vector<File>				files;
+		atomic<bool>				bReloadRequested;
+};
@@ -2,14 +2,25 @@
 
 #define VERSION_NUM 6
 
+const string renderModeNames[RENDER_MODE_COUNT] = { "always", "throttled", "focused", "keypress", "blank" };
+
 //--------------------------------------------------------------
 void ofApp::setup(){
 
+	// only the window, skeletons go out at FRAMERATE from captureThread
 	ofSetFrameRate(FRAMERATE);
+	ofSetVerticalSync(false);
 
 	// basic initialization
 	ofBackground(0);
 	bPause = false;
+	lastRenderTime = -1;
+	lastKeyTime = 0;
+	bAppearanceUpdated = false;
+	frameId = 0;
+	captureMicros = 0;
+	oscPort = 0;
+	bOscConnected = false;
 
 	// sets window to the size of the screen and positions it in the
 	// upper left-hand corner
@@ -20,8 +31,19 @@ void ofApp::setup(){
 	loadDisplayXml();
 
 	// get host config from XML and init OSC
+	channels.push_back(&userLocChannel);
+	channels.push_back(&restrictedChannel);
+	channels.push_back(&handStateChannel);
+	channels.push_back(&leanChannel);
+	channels.push_back(&jointChannel);
+	channels.push_back(&floorChannel);
 	loadInitOsc();
 
+	// from here on changes to either file are parsed in the background and applied in update()
+	settingsWatcher.watch("settings.xml");
+	settingsWatcher.watch("hostconfig.xml");
+	settingsWatcher.start();
+
 	// initialize Kinect2 and all its streams
 	kinect.open();
 	kinect.initDepthSource();
@@ -30,6 +52,13 @@ void ofApp::setup(){
 	kinect.initBodySource();
 	kinect.initBodyIndexSource();
 
+	// textures are uploaded in draw() only when a frame is actually rendered,
+	// so the sources shouldn't upload their own every update
+	kinect.getDepthSource()->setUseTexture(false);
+	kinect.getColorSource()->setUseTexture(false);
+	kinect.getInfraredSource()->setUseTexture(false);
+	kinect.getBodyIndexSource()->setUseTexture(false);
+
 
 
 	// Joint names for OSC are different, so create a map
@@ -73,6 +102,15 @@ void ofApp::setup(){
 	handStates[HandState_Lasso] = "lasso";
 
 	windowResized(ofGetWidth(), ofGetHeight());
+
+	// capture and send from here on, whatever draw() is doing
+	captureThread.start(FRAMERATE, [this] { capture(); });
+}
+
+//--------------------------------------------------------------
+void ofApp::exit() {
+	// before the kinect and the sender go
+	captureThread.stop();
 }
 
 //--------------------------------------------------------------
@@ -90,6 +128,16 @@ void ofApp::loadDisplayXml() {
 		ofLogNotice("setting depthGain to 20");
 		ofLogNotice("setting depthGain to TRUE");
 	}
+	applyDisplayXml(settings);
+
+	// only at startup, a reload would flip it back
+	if (settings.getValue("display_config:bStartFullscreen", true)) {
+		ofToggleFullscreen();
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::applyDisplayXml(ofxXmlSettings & settings) {
 
 	// set boolean values
 	settings.pushTag("display_config");
@@ -101,9 +149,23 @@ void ofApp::loadDisplayXml() {
 	depthGain = settings.getValue("depthGain", 20);
 	bDepthInvert = settings.getValue("bDepthInvert", true);
 	bDrawFloor = settings.getValue("bDrawFloor", false);
-	if (settings.getValue("bStartFullscreen", true)) {
-		ofToggleFullscreen();
+	renderFps = settings.getValue("renderFps", 5.0);
+	renderHoldTime = settings.getValue("renderHoldTime", 10.0);
+
+	string renderModeName = settings.getValue("renderMode", "always");
+	renderMode = RENDER_ALWAYS;
+	for (int i = 0; i < RENDER_MODE_COUNT; i++) {
+		if (renderModeName == renderModeNames[i]) renderMode = i;
 	}
+	lastRenderTime = -1;
+	settings.popTag();
+
+	// appearance descriptor settings
+	settings.pushTag("appearance_config");
+	appearance.bEnabled = settings.getValue("bEnabled", true);
+	appearance.intervalFrames = settings.getValue("intervalFrames", 15);
+	appearance.sampleStride = settings.getValue("sampleStride", 2);
+	settings.popTag();
 }
 
 //--------------------------------------------------------------
@@ -116,11 +178,30 @@ void ofApp::loadInitOsc() {
 		ofLogNotice("setting ip_address to 192.168.10.100");
 		ofLogNotice("setting port to 8001");
 	}
-	oscXml.pushTag("osc_config");
-	oscHostname = oscXml.getValue("ip_address", "192.168.10.100");
-	oscPort = oscXml.getValue("port", 8001);
+	applyOscXml(oscXml);
+}
 
-	// initialize OSC sender
+//--------------------------------------------------------------
+void ofApp::applyOscXml(ofxXmlSettings & oscXml) {
+	oscXml.pushTag("osc_config");
+	string hostname = oscXml.getValue("ip_address", "192.168.10.100");
+	int port = oscXml.getValue("port", 8001);
+	oscXml.popTag();
+
+	// per message class send policies, see OutputChannel.h
+	bool bChannelConfig = oscXml.pushTag("channel_config");
+	userLocChannel.loadXml(oscXml, "user", OutputChannel::EVERY_FRAME);
+	restrictedChannel.loadXml(oscXml, "restricted", OutputChannel::ON_CHANGE);
+	handStateChannel.loadXml(oscXml, "handstate", OutputChannel::ON_CHANGE);
+	leanChannel.loadXml(oscXml, "lean", OutputChannel::ON_CHANGE);
+	jointChannel.loadXml(oscXml, "skel", OutputChannel::EVERY_FRAME);
+	floorChannel.loadXml(oscXml, "floorplane", OutputChannel::RATE);
+	if (bChannelConfig) oscXml.popTag();
+
+	// initialize OSC sender, only again if it's to go somewhere else (or didn't work)
+	if (bOscConnected && hostname == oscHostname && port == oscPort) return;
+	oscHostname = hostname;
+	oscPort = port;
 	bOscConnected = true;
 	try {
 		oscSkelSender.setup(oscHostname, oscPort);
@@ -133,17 +214,43 @@ void ofApp::loadInitOsc() {
 
 //--------------------------------------------------------------
 void ofApp::update(){
+	// settings changed on disk, parsed in the background, go in between two captured frames
+	shared_ptr<ofxXmlSettings> settings = settingsWatcher.take("settings.xml");
+	shared_ptr<ofxXmlSettings> oscXml = settingsWatcher.take("hostconfig.xml");
+	if (settings || oscXml) {
+		std::unique_lock<std::mutex> lock(captureMutex);
+		if (settings) applyDisplayXml(*settings);
+		if (oscXml) applyOscXml(*oscXml);
+	}
+	if (settings) windowResized(ofGetWidth(), ofGetHeight());
+}
+
+//--------------------------------------------------------------
+void ofApp::capture(){
+	// on captureThread. draw() only holds the lock to copy what it needs out
+	std::unique_lock<std::mutex> lock(captureMutex);
+
 	if (!bPause) {
 		// update Kinect2
 		kinect.update();
 
 		// need to process skeletal data for a variety of tasks later
 		getSkelData();
+		frameId++;
+		captureMicros = ofGetElapsedTimeMicros();
+
+		// torso color histograms, only recomputed at a low rate
+		bAppearanceUpdated = appearance.update(kinect, trackedUsers);
+	}
+	else {
+		bAppearanceUpdated = false;
 	}
 
 	// create OSC data bundle
 	oscBundle.clear();
+	for (auto channel : channels) channel->beginFrame(ofGetElapsedTimef());
 
+	bundleFrame();
 	bundleNewUsers();
 	bundleLostUsers();
 	bundleCalib();
@@ -153,6 +260,9 @@ void ofApp::update(){
 	bundleLean();
 	bundleJoints();
 	bundleFloor();
+	bundleAppearance();
+
+	for (auto channel : channels) channel->endFrame();
 
 	// send the bundle
 	if (bOscConnected)	oscSkelSender.sendBundle(oscBundle);
@@ -205,6 +315,18 @@ void ofApp::getSkelData()
 
 }
 
+//--------------------------------------------------------------
+void ofApp::bundleFrame() {
+	// first message of every bundle, receivers use it to keep frames apart
+	// /frame	frameId captureMicros
+	ofxOscMessage m;
+	m.setAddress("/frame");
+	m.addIntArg(frameId);
+	m.addInt64Arg(captureMicros);
+
+	oscBundle.addMessage(m);
+}
+
 //--------------------------------------------------------------
 void ofApp::bundleNewUsers()
 {
@@ -264,7 +386,7 @@ void ofApp::bundleUserLoc()
 		m.addIntArg(0);
 
 
-		oscBundle.addMessage(m);
+		userLocChannel.add(oscBundle, m);
 	}
 }
 
@@ -281,7 +403,7 @@ void ofApp::bundleRestricted()
 		// fake confidence value
 		m.addFloatArg(1.0);
 
-		oscBundle.addMessage(m);
+		restrictedChannel.add(oscBundle, m);
 	}
 
 }
@@ -304,8 +426,8 @@ void ofApp::bundleHandStates()
 		n.addFloatArg(body.rightHandConfidence);
 
 		
-		oscBundle.addMessage(m);
-		oscBundle.addMessage(n);
+		handStateChannel.add(oscBundle, m);
+		handStateChannel.add(oscBundle, n);
 	}
 }
 
@@ -323,7 +445,7 @@ void ofApp::bundleLean()
 		//fake confidence value
 		m.addFloatArg(1.0);
 
-		oscBundle.addMessage(m);
+		leanChannel.add(oscBundle, m);
 	}
 }
 
@@ -365,7 +487,7 @@ void ofApp::bundleJoints()
 			m.addFloatArg(velContainer[it->second].distance(ofVec3f(0, 0, 0)));
 
 			// add message to the bundle
-			oscBundle.addMessage(m);
+			jointChannel.add(oscBundle, m);
 		}
 	}
 }
@@ -381,12 +503,87 @@ void ofApp::bundleFloor() {
 	m.addFloatArg(floorCoord.z);
 	m.addFloatArg(floorCoord.w);
 
-	oscBundle.addMessage(m);
+	floorChannel.add(oscBundle, m);
+}
+
+//--------------------------------------------------------------
+void ofApp::bundleAppearance() {
+	// only send when the descriptors have been recomputed this frame
+	// /appearance/userID	sampleCount histogram(blob of APPEARANCE_BINS bytes)
+	if (!bAppearanceUpdated) return;
+
+	for (auto & body : trackedUsers) {
+		const AppearanceDescriptor::Descriptor & descriptor = appearance.get(body.bodyId);
+		if (!descriptor.valid) continue;
+
+		ofBuffer blob((const char *)descriptor.bins, APPEARANCE_BINS);
+
+		ofxOscMessage m;
+		m.setAddress("/appearance/" + ofToString(body.bodyId));
+		m.addIntArg(descriptor.sampleCount);
+		m.addBlobArg(blob);
+
+		oscBundle.addMessage(m);
+	}
 }
 
 //--------------------------------------------------------------
 void ofApp::draw(){
 
+	// skeleton capture and sending happen on captureThread regardless of what is drawn here
+	if (renderMode != RENDER_BLANK) {
+		if (isRenderDue()) {
+			renderFbo.begin();
+			ofClear(0, 255);
+			drawScene();
+			renderFbo.end();
+			lastRenderTime = ofGetElapsedTimef();
+		}
+
+		ofSetColor(255);
+		if (lastRenderTime >= 0) renderFbo.draw(0, 0);
+	}
+
+	// drawn over the cached scene every frame, so the fps stays current between renders
+	ofPushStyle();
+	ofSetColor(255, displayTextAlpha);
+	ofDrawBitmapString("render: " + renderModeNames[renderMode] + " ('r' to change)  fps: " + ofToString(ofGetFrameRate(), 2),
+		20, ofGetHeight() - 20);
+	ofPopStyle();
+}
+
+//--------------------------------------------------------------
+bool ofApp::isRenderDue() {
+	float now = ofGetElapsedTimef();
+
+	// always draw the first frame so there is something on screen
+	if (lastRenderTime < 0) return true;
+
+	switch (renderMode) {
+	case RENDER_THROTTLED:
+		return now - lastRenderTime >= 1.0 / max(renderFps, 0.1f);
+
+	case RENDER_FOCUSED:
+#ifdef TARGET_WIN32
+		return GetForegroundWindow() == ofGetWin32Window();
+#else
+		return true;
+#endif
+
+	case RENDER_KEYPRESS:
+		return now - lastKeyTime < renderHoldTime;
+
+	case RENDER_BLANK:
+		return false;
+
+	default:
+		return true;
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::drawScene(){
+
 	// draw either the depth image or the color image
 	if (bShowDepth) {
 		ofSetColor(displayDepthAlpha);
@@ -404,13 +601,22 @@ void ofApp::draw(){
 	// overlay the skeletons and hand state bubbles on the video
 	drawSkeleton();
 
+	// the last bundle sent, copied so the capture thread can go on
+	int messageCount;
+	ofxOscBundle bundle;
+	{
+		std::unique_lock<std::mutex> lock(captureMutex);
+		messageCount = oscBundle.getMessageCount();
+		if (bDrawDebug) bundle = oscBundle;
+	}
+
 	stringstream displayStream;
 	displayStream << "version v" + ofToString(VERSION_NUM) << endl;
-	displayStream << "fps: " + ofToString(ofGetFrameRate(), 2) << endl;
+	displayStream << "osc messages: " + ofToString(messageCount) << endl;
 
 	if (bDrawDebug) {
-		for (int i = 0; i < oscBundle.getMessageCount(); i++) {
-			ofxOscMessage tempMessage = oscBundle.getMessageAt(i);
+		for (int i = 0; i < bundle.getMessageCount(); i++) {
+			ofxOscMessage tempMessage = bundle.getMessageAt(i);
 			displayStream << toString(tempMessage);
 			displayStream << endl;
 		}
@@ -425,7 +631,10 @@ void ofApp::draw(){
 //--------------------------------------------------------------
 void ofApp::drawDepth() {
 	// taken from EW's example
-	depthPixelsCopy.setFromPixels(kinect.getDepthSource()->getPixels(), DEPTH_WIDTH, DEPTH_HEIGHT, OF_IMAGE_GRAYSCALE);
+	{
+		std::unique_lock<std::mutex> lock(captureMutex);
+		depthPixelsCopy.setFromPixels(kinect.getDepthSource()->getPixels(), DEPTH_WIDTH, DEPTH_HEIGHT, OF_IMAGE_GRAYSCALE);
+	}
 	auto tempPixelsIt = depthPixelsCopy.begin();
 	for (int i = 0; tempPixelsIt + i < depthPixelsCopy.end(); i++) {
 		if (tempPixelsIt[i] > 0) {	// if not undefined...
@@ -441,13 +650,20 @@ void ofApp::drawDepth() {
 
 //--------------------------------------------------------------
 void ofApp::drawColor() {
-	// taken from EW's example
-	kinect.getColorSource()->draw(displayOffset.x, displayOffset.y, displayWidth, displayHeight);
+	// taken from EW's example, but uploading the texture ourselves so it only
+	// happens when a frame is rendered, and from a copy so the upload doesn't hold up capture
+	{
+		std::unique_lock<std::mutex> lock(captureMutex);
+		colorPixelsCopy = kinect.getColorSource()->getPixels();
+	}
+	colorTexture.loadData(colorPixelsCopy);
+	colorTexture.draw(displayOffset.x, displayOffset.y, displayWidth, displayHeight);
 }
 
 //--------------------------------------------------------------
 void ofApp::drawSkeleton() {
-	// taken from EW's example
+	// taken from EW's example. only a few lines, drawn straight from the body source
+	std::unique_lock<std::mutex> lock(captureMutex);
 	if (bShowDepth) {
 		kinect.getBodySource()->drawProjected(displayOffset.x, displayOffset.y, displayWidth, displayHeight, ofxKFW2::ProjectionCoordinates::DepthCamera);
 	}
@@ -459,6 +675,9 @@ void ofApp::drawSkeleton() {
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key){
 
+	// wakes up the RENDER_KEYPRESS mode
+	lastKeyTime = ofGetElapsedTimef();
+
 	switch (key)
 	{
 	// toggle fullscreen
@@ -481,23 +700,30 @@ void ofApp::keyPressed(int key){
 		break;
 
 	case 'p':
-	case 'P':
+	case 'P': {
+		std::unique_lock<std::mutex> lock(captureMutex);
 		bPause = !bPause;
 		break;
+	}
 
 	case 'i':
 	case 'I':
 		bDepthInvert = !bDepthInvert;
 		break;
 
+	// both files are reloaded in the background, see update()
 	case 'l':
 	case 'L':
-		loadDisplayXml();
-		break;
-
 	case 'o':
 	case 'O':
-		loadInitOsc();
+		settingsWatcher.reload();
+		break;
+
+	// cycle render modes
+	case 'r':
+	case 'R':
+		renderMode = (renderMode + 1) % RENDER_MODE_COUNT;
+		lastRenderTime = -1;
 		break;
 	}
 
@@ -540,6 +766,10 @@ void ofApp::mouseExited(int x, int y){
 
 //--------------------------------------------------------------
 void ofApp::windowResized(int w, int h){
+	// cached frame matches the window (skip while minimized)
+	if (w > 0 && h > 0) renderFbo.allocate(w, h, GL_RGB);
+	lastRenderTime = -1;
+
 	// calculate the ratio of width to height for comparison
 	// (taking into account the border)
 	float ratio = (float(w) - 2.0*OFFSET_X)/(float(h) - 2.0*OFFSET_Y);
@@ -5,6 +5,10 @@
 #include "ofxXmlSettings.h"
 #include "ofxKinectForWindows2.h"
 #include "ofxOsc.h"
+#include "AppearanceDescriptor.h"
+#include "OutputChannel.h"
+#include "SettingsWatcher.h"
+#include "CaptureThread.h"
 
 
 
@@ -16,6 +20,19 @@
 #define OFFSET_Y 10
 #define FRAMERATE 30
 
+// how often the window is redrawn, independent of the capture and send rate
+enum RenderMode {
+	RENDER_ALWAYS,		// every frame
+	RENDER_THROTTLED,	// at renderFps
+	RENDER_FOCUSED,		// every frame while the window has focus, otherwise not at all
+	RENDER_KEYPRESS,	// for renderHoldTime seconds after a keypress
+	RENDER_BLANK,		// never, only a status line
+	RENDER_MODE_COUNT
+};
+
+// as in settings.xml and the status line, indexed by RenderMode
+extern const string renderModeNames[RENDER_MODE_COUNT];
+
 
 class ofApp : public ofBaseApp{
 
@@ -23,9 +40,14 @@ class ofApp : public ofBaseApp{
 		void setup();
 		void loadDisplayXml();
 		void loadInitOsc();
+		void applyDisplayXml(ofxXmlSettings & settings);
+		void applyOscXml(ofxXmlSettings & oscXml);
 
 		void update();
+		void exit();
+		void capture();
 		void getSkelData();
+		void bundleFrame();
 		void bundleNewUsers();
 		void bundleLostUsers();
 		void bundleCalib();
@@ -35,8 +57,11 @@ class ofApp : public ofBaseApp{
 		void bundleLean();
 		void bundleJoints();
 		void bundleFloor();
+		void bundleAppearance();
 
 		void draw();
+		bool isRenderDue();
+		void drawScene();
 		void drawDepth();
 		void drawColor();
 		void drawSkeleton();
@@ -66,8 +91,19 @@ class ofApp : public ofBaseApp{
 		float						depthGain;
 		bool						bDepthInvert;
 		bool						bDrawFloor;
+		int							renderMode;
+		float						renderFps;
+		float						renderHoldTime;
 		ofVec4f						floorCoord;
 
+		// reloads settings.xml and hostconfig.xml when they change
+		SettingsWatcher				settingsWatcher;
+
+		// runs capture() at FRAMERATE. everything capture() touches that draw() or
+		// the settings also touch is guarded by captureMutex
+		CaptureThread				captureThread;
+		std::mutex					captureMutex;
+
 
 		ofVec2f						displayOffset;
 		int							displayWidth;
@@ -79,6 +115,19 @@ class ofApp : public ofBaseApp{
 		ofxOscSender				oscSkelSender;
 		bool						bOscConnected;
 		ofxOscBundle				oscBundle;
+
+		// id and capture time of the skeleton frame being sent, so receivers can tell frames apart
+		int							frameId;
+		uint64_t					captureMicros;
+
+		// send policies for the message classes that rarely change
+		OutputChannel				userLocChannel;
+		OutputChannel				restrictedChannel;
+		OutputChannel				handStateChannel;
+		OutputChannel				leanChannel;
+		OutputChannel				jointChannel;
+		OutputChannel				floorChannel;
+		vector<OutputChannel *>		channels;
 		map<string, JointType>		jointNames;
 		string						handStates[5];
 
@@ -91,8 +140,19 @@ class ofApp : public ofBaseApp{
 		vector<ofxKFW2::Data::Body> newUsers;
 		vector<ofxKFW2::Data::Body> lostUsers;
 
+		AppearanceDescriptor		appearance;
+		bool						bAppearanceUpdated;
+
+		// copied from the sources under captureMutex, converted and uploaded outside it
 		ofShortPixels				depthPixelsCopy;
+		ofPixels					colorPixelsCopy;
 		ofTexture					depthTexture;
+		ofTexture					colorTexture;
+
+		// last rendered frame, redrawn while the scene isn't due
+		ofFbo						renderFbo;
+		float						lastRenderTime;
+		float						lastKeyTime;
 
 		static bool sortSkelsFunc(const ofxKFW2::Data::Body &skel1, const ofxKFW2::Data::Body &skel2) {
 			return (skel1.trackingId < skel2.trackingId); }